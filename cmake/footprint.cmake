@@ -0,0 +1,26 @@
+# Prints the RAM figures of the ztl objects from the linked image.
+# Invoked after the build with -DNM=<nm> -DELF=<zephyr.elf>.
+
+execute_process(
+  COMMAND ${NM} --defined-only --radix=d ${ELF}
+  OUTPUT_VARIABLE symbols
+  RESULT_VARIABLE result
+)
+if(NOT result EQUAL 0)
+  message(WARNING "ztl footprint: ${NM} failed on ${ELF}")
+  return()
+endif()
+
+string(REGEX MATCHALL "[0-9]+ [Aa] ztl_sizeof_[a-z_]+" entries "${symbols}")
+
+set(lines "")
+foreach(entry ${entries})
+  string(REGEX REPLACE "^0*([0-9]*) [Aa] ztl_sizeof_([a-z_]+)$" "\\2: \\1" line "${entry}")
+  list(APPEND lines "${line}")
+endforeach()
+list(SORT lines)
+
+message(STATUS "ztl RAM footprint (bytes):")
+foreach(line ${lines})
+  message(STATUS "  ${line}")
+endforeach()
@@ -0,0 +1,16 @@
+# Builds the library into the app of a test suite, included after
+# find_package(Zephyr). The sources include <lib/safe-c/safe_c.h> of the
+# application, point ZTL_SAFE_C_DIR at the directory holding lib/:
+#   west twister -T tests -p native_sim -x=ZTL_SAFE_C_DIR=<dir>
+
+set(ZTL_SAFE_C_DIR "" CACHE PATH "Directory holding lib/safe-c/safe_c.h")
+if(NOT EXISTS ${ZTL_SAFE_C_DIR}/lib/safe-c/safe_c.h)
+  message(FATAL_ERROR "ZTL_SAFE_C_DIR must hold lib/safe-c/safe_c.h")
+endif()
+
+# Not an include directory, time.h there would shadow the libc one. Tests
+# include the library headers by relative path.
+get_filename_component(ZTL_ROOT ${CMAKE_CURRENT_LIST_DIR}/.. ABSOLUTE)
+
+target_include_directories(app PRIVATE ${ZTL_SAFE_C_DIR})
+add_subdirectory(${ZTL_ROOT} ${CMAKE_BINARY_DIR}/ztl)
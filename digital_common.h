@@ -1,6 +1,15 @@
 #ifndef ZTL_DIGITAL_COMMON_H_
 #define ZTL_DIGITAL_COMMON_H_
 
+#include <zephyr/autoconf.h>
+
+// Bit-field width of a member in the compact layout, full width otherwise
+#if defined(CONFIG_ZTL_COMPACT_LAYOUT)
+#define ZTL_BITS(n) : n
+#else
+#define ZTL_BITS(n)
+#endif
+
 typedef enum ZtlLevel {
     ZTL_LEVEL__LOW = 0,
     ZTL_LEVEL__HIGH = 1,
@@ -1,132 +1,1124 @@
 #include "digital_input.h"
+#include "io_engine.h"
 #include "time.h"
+#include "vertical_debounce.h"
+
+#if defined(CONFIG_ZTL_QUADRATURE)
+#include "quadrature.h"
+#endif
+
+#if defined(CONFIG_ZTL_REFLEX)
+#include "reflex.h"
+#endif
+
+#if defined(CONFIG_ZTL_SHIFT_REGISTER)
+#include "shift_register.h"
+#endif
 
 #include <lib/safe-c/safe_c.h>
 
+#include <zephyr/init.h>
 #include <zephyr/kernel.h>
+#include <zephyr/toolchain.h>
+#include <zephyr/sys/barrier.h>
+#include <zephyr/sys/math_extras.h>
 
 enum {
     DEFAULT_DEBOUNCE_DURATION_MS = 100,
-    THREAD_STACK_SIZE = 512,
-    THREAD_LOOP_SLEEP_US = 1000,
-    THREAD_PRIO = 3,
+    HEAP_IDX_NONE = UINT8_MAX,
+};
+
+// Bits of ZtlDigitalInput::flags, the state published to lock-free readers
+enum {
+    FLAG_STATE = BIT(0),
+    FLAG_STATE_DEBOUNCED = BIT(1),
+    FLAG_CHANGED = BIT(2),
+    FLAG_CHANGED_DEBOUNCED = BIT(3),
+    FLAG_CHANGED_DEBOUNCED_BUTTON = BIT(4),
 };
 
 LOG_MODULE_REGISTER(ztl_digital_input);
 
+typedef struct InputPort {
+    struct device const* dev;
+    gpio_port_pins_t active_low_mask;
+    gpio_port_value_t raw;
+    bool is_sampled;
+    // Pins debounced with vertical counters, fed with the first port sample
+    // of each engine scan. Reads for application queries don't count.
+    gpio_port_pins_t vc_mask;
+    bool is_vc_updated;
+    struct ZtlVerticalDebounce vc;
+} InputPort;
+
 static struct ZtlDigitalInput* g_inputs[CONFIG_ZTL_DIGITAL_INPUT_MAX_COUNT] = {0};
+// Ports of the registered inputs, each one is read once per scan
+static struct InputPort g_ports[CONFIG_ZTL_DIGITAL_INPUT_MAX_COUNT] = {0};
+static uint8_t g_ports_count = 0;
 K_MUTEX_DEFINE(g_inputs_mutex);
+#if defined(CONFIG_ZTL_INSTRUMENTATION)
+// Under g_inputs_mutex
+static struct ZtlInstrumentEngineStats g_engine_stats = {0};
+static uint64_t g_engine_scheduled_us = UINT64_MAX;
+#endif
+// Broadcast on every raw or debounced state change, guarded by g_inputs_mutex
+K_CONDVAR_DEFINE(g_inputs_changed);
+
+static inline void lock_inputs(void) {
+#if defined(CONFIG_ZTL_INSTRUMENTATION)
+    ztl_instrument__lock(&g_inputs_mutex, &g_engine_stats);
+#else
+    k_mutex_lock(&g_inputs_mutex, K_FOREVER);
+#endif
+}
+
+#if defined(CONFIG_ZTL_INSTRUMENTATION)
+// Written by the one context that runs the callbacks, queries may read torn figures
+static inline void record_callback(struct ZtlDigitalInputCallbackDescriptor* const cb_descr, uint32_t const latency_us, uint32_t const cyc) {
+    cb_descr->calls++;
+    cb_descr->latency_last_us = latency_us;
+    cb_descr->latency_max_us = MAX(cb_descr->latency_max_us, latency_us);
+    cb_descr->callback_last_cyc = cyc;
+    cb_descr->callback_max_cyc = MAX(cb_descr->callback_max_cyc, cyc);
+}
+
+static inline void reset_callback_stats(struct ZtlDigitalInputCallbackDescriptor* const cb_descr) {
+    cb_descr->calls = 0;
+    cb_descr->latency_last_us = 0;
+    cb_descr->latency_max_us = 0;
+    cb_descr->callback_last_cyc = 0;
+    cb_descr->callback_max_cyc = 0;
+}
+#endif
+
+// Keeps readers in ISRs from preempting a half published snapshot
+static struct k_spinlock g_publish_lock;
+
+BUILD_ASSERT(CONFIG_ZTL_DIGITAL_INPUT_MAX_COUNT < HEAP_IDX_NONE, "Input indexes must fit 8 bits");
+BUILD_ASSERT(CONFIG_ZTL_DIGITAL_INPUT_MAX_SUBSCRIBERS_COUNT <= 16, "Subscribers must fit 16-bit masks");
+
+// Inputs with a pending sample or deadline, min-heap on tl_deadline
+static struct ZtlDigitalInput* g_deadline_heap[CONFIG_ZTL_DIGITAL_INPUT_MAX_COUNT];
+static uint8_t g_deadline_heap_count = 0;
+
+// States of all inputs by index, bank N holds inputs 64 * N to 64 * N + 63.
+// Updated under g_inputs_mutex while scanning.
+static uint64_t g_scan_raw_mask[ZTL_DIGITAL_INPUT_BANK_COUNT] = {0};
+static uint64_t g_scan_debounced_mask[ZTL_DIGITAL_INPUT_BANK_COUNT] = {0};
+// Copies of the scan masks taken when a scan completes, under g_publish_lock
+static uint64_t g_raw_mask[ZTL_DIGITAL_INPUT_BANK_COUNT] = {0};
+static uint64_t g_debounced_mask[ZTL_DIGITAL_INPUT_BANK_COUNT] = {0};
+
+#if defined(CONFIG_ZTL_DIGITAL_INPUT_EDGE_CAPTURE)
+static struct k_spinlock g_edges_lock;
+// Inputs by index with edges not handled yet, banked like the state masks, under g_edges_lock
+static uint64_t g_edges_pending[ZTL_DIGITAL_INPUT_BANK_COUNT] = {0};
+#endif
+
+#if defined(CONFIG_ZTL_REFLEX)
+// Cycle counter at the start of the current scan, reflex reaction times count from it
+static uint32_t g_scan_cycles = 0;
+#endif
+
+static void publish_flags(struct ZtlDigitalInput* const self, atomic_val_t const set, atomic_val_t const clear) {
+    atomic_val_t old;
+    do {
+        old = atomic_get(&self->flags);
+    } while (!atomic_cas(&self->flags, old, (old & ~clear) | set));
+}
+
+static inline void update_mask(uint64_t* const masks, uint8_t const index, bool const state) {
+    uint64_t* const mask = &masks[index / 64];
+    if (state) {
+        *mask |= BIT64(index % 64);
+    } else {
+        *mask &= ~BIT64(index % 64);
+    }
+}
+
+static void publish_masks(void) {
+    k_spinlock_key_t const key = k_spin_lock(&g_publish_lock);
+    memcpy(g_raw_mask, g_scan_raw_mask, sizeof(g_raw_mask));
+    memcpy(g_debounced_mask, g_scan_debounced_mask, sizeof(g_debounced_mask));
+    k_spin_unlock(&g_publish_lock, key);
+}
+
+static void publish_state_change(struct ZtlDigitalInput* const self, bool const state, uint64_t const now) {
+    update_mask(g_scan_raw_mask, self->index, state);
+
+    k_spinlock_key_t const key = k_spin_lock(&g_publish_lock);
+    atomic_inc(&self->seq);
+    self->tl_state_change = now;
+    publish_flags(self, FLAG_CHANGED | (state ? FLAG_STATE : 0), state ? 0 : FLAG_STATE);
+    atomic_inc(&self->seq);
+    k_spin_unlock(&g_publish_lock, key);
+}
+
+// Wait-free unless the writer runs on another CPU right now
+static void read_snapshot(struct ZtlDigitalInput const* const self, atomic_val_t* const flags, ztl_stamp_t* const tl_state_change) {
+    while (true) {
+        atomic_val_t const seq = atomic_get(&self->seq);
+        if (seq & 1) {
+            continue;
+        }
+        *flags = atomic_get(&self->flags);
+        *tl_state_change = self->tl_state_change;
+        barrier_dmem_fence_full();
+        if (seq == atomic_get(&self->seq)) {
+            return;
+        }
+    }
+}
+
+#if defined(CONFIG_ZTL_DIGITAL_INPUT_DEFERRED_DISPATCH)
+
+enum {
+    DISPATCH_QUEUE_SIZE = CONFIG_ZTL_DIGITAL_INPUT_DISPATCH_QUEUE_SIZE,
+};
+
+BUILD_ASSERT(IS_POWER_OF_TWO(DISPATCH_QUEUE_SIZE), "Dispatch queue size must be a power of two");
+
+typedef struct DispatchRecord {
+    struct ZtlDigitalInput* input;
+    uint64_t timestamp;
+    uint8_t sub_idx;
+    uint8_t event;
+} DispatchRecord;
+
+// Single producer (whoever holds g_inputs_mutex), single consumer (dispatch
+// work). Both touch the records under g_inputs_mutex, the callbacks run without it.
+typedef struct DispatchRing {
+    struct DispatchRecord records[DISPATCH_QUEUE_SIZE];
+    atomic_t head;
+    atomic_t tail;
+} DispatchRing;
+
+static struct DispatchRing g_dispatch_rings[ZTL_DIGITAL_INPUT_PRIORITY__COUNT];
+static atomic_t g_dispatch_dispatched = ATOMIC_INIT(0);
+static atomic_t g_dispatch_coalesced = ATOMIC_INIT(0);
+static atomic_t g_dispatch_overflows = ATOMIC_INIT(0);
+static struct k_work_q* g_dispatch_queue = NULL;
+// Timestamp of the event being delivered, only touched from the dispatch work
+static uint64_t g_dispatch_timestamp = 0;
+
+static void dispatch_work_handler(struct k_work* work);
+
+K_WORK_DEFINE(g_dispatch_work, dispatch_work_handler);
+
+// Call under g_inputs_mutex
+static bool dispatch_ring_pop(struct DispatchRing* const ring, struct DispatchRecord* const record) {
+    atomic_val_t const tail = atomic_get(&ring->tail);
+    if (tail == atomic_get(&ring->head)) {
+        return false;
+    }
+    *record = ring->records[tail & (DISPATCH_QUEUE_SIZE - 1)];
+    atomic_set(&ring->tail, tail + 1);
+
+    // Events raised from now on are queued again
+    if (record->input) {
+        struct ZtlDigitalInputCallbackDescriptor* const cb_descr = &record->input->callback_descriptors[record->sub_idx];
+        if (cb_descr->is_queued && (uint32_t)tail == cb_descr->queued_pos) {
+            cb_descr->is_queued = false;
+        }
+    }
+
+    return true;
+}
+
+// The callback and arg were read with the record, NULL for a dropped one
+static void dispatch_record(struct DispatchRecord const* const record, ZtlDigitalInputCallback const callback, void* const arg) {
+    if (callback) {
+        g_dispatch_timestamp = record->timestamp;
+#if defined(CONFIG_ZTL_INSTRUMENTATION)
+        uint32_t const latency_us = (uint32_t)(ztl_time__now_us() - record->timestamp);
+        uint32_t const start_cyc = k_cycle_get_32();
+#endif
+        callback((enum ZtlDigitalInputEventType)record->event, arg);
+#if defined(CONFIG_ZTL_INSTRUMENTATION)
+        record_callback(&record->input->callback_descriptors[record->sub_idx], latency_us, k_cycle_get_32() - start_cyc);
+#endif
+        atomic_inc(&g_dispatch_dispatched);
+    }
+}
+
+static void dispatch_work_handler(struct k_work* const work) {
+    struct DispatchRecord record;
+
+    while (true) {
+        lock_inputs();
+        // High priority records always go first
+        bool const is_popped = dispatch_ring_pop(&g_dispatch_rings[ZTL_DIGITAL_INPUT_PRIORITY__HIGH], &record) ||
+                               dispatch_ring_pop(&g_dispatch_rings[ZTL_DIGITAL_INPUT_PRIORITY__NORMAL], &record);
+        ZtlDigitalInputCallback callback = NULL;
+        void* arg = NULL;
+        if (is_popped && record.input) {
+            callback = record.input->callback_descriptors[record.sub_idx].callback;
+            arg = record.input->callback_descriptors[record.sub_idx].arg;
+        }
+        k_mutex_unlock(&g_inputs_mutex);
+
+        if (!is_popped) {
+            break;
+        }
+        dispatch_record(&record, callback, arg);
+    }
+}
+
+static inline void call_subs(
+    struct ZtlDigitalInput* const self,
+    struct ZtlDigitalInputCallbackDescriptor* const cb_descr,
+    enum ZtlDigitalInputEventType const event,
+    uint64_t const now)
+{
+    struct DispatchRing* const ring = &g_dispatch_rings[cb_descr->priority];
+
+    // A repeat of the last undelivered event of this subscriber only moves
+    // its timestamp, other events keep their order behind it
+    if (cb_descr->is_queued && event == cb_descr->queued_event) {
+        ring->records[cb_descr->queued_pos & (DISPATCH_QUEUE_SIZE - 1)].timestamp = now;
+        atomic_inc(&g_dispatch_coalesced);
+        return;
+    }
+
+    atomic_val_t const head = atomic_get(&ring->head);
+    if (head - atomic_get(&ring->tail) >= DISPATCH_QUEUE_SIZE) {
+        atomic_inc(&g_dispatch_overflows);
+        return;
+    }
 
-static void input_handler(void*, void*, void*);
+    ring->records[head & (DISPATCH_QUEUE_SIZE - 1)] = (struct DispatchRecord){
+        .input = self,
+        .timestamp = now,
+        .sub_idx = (uint8_t)(cb_descr - self->callback_descriptors),
+        .event = (uint8_t)event,
+    };
+    atomic_set(&ring->head, head + 1);
+    cb_descr->is_queued = true;
+    cb_descr->queued_event = event;
+    cb_descr->queued_pos = (uint32_t)head;
 
-K_THREAD_DEFINE(input_handler_tid, THREAD_STACK_SIZE,
-                input_handler, NULL, NULL, NULL,
-                THREAD_PRIO, 0, 0);
+    if (g_dispatch_queue) {
+        k_work_submit_to_queue(g_dispatch_queue, &g_dispatch_work);
+    } else {
+        k_work_submit(&g_dispatch_work);
+    }
+}
+
+// Records of the input still in the rings are delivered to nobody. Call
+// under g_inputs_mutex.
+static void drop_dispatch_records(struct ZtlDigitalInput* const self) {
+    for (uint8_t p = 0; p < ZTL_DIGITAL_INPUT_PRIORITY__COUNT; p++) {
+        struct DispatchRing* const ring = &g_dispatch_rings[p];
+        for (atomic_val_t pos = atomic_get(&ring->tail); pos != atomic_get(&ring->head); pos++) {
+            struct DispatchRecord* const record = &ring->records[pos & (DISPATCH_QUEUE_SIZE - 1)];
+            if (self == record->input) {
+                record->input = NULL;
+            }
+        }
+    }
+    for (uint8_t i = 0; i < CONFIG_ZTL_DIGITAL_INPUT_MAX_SUBSCRIBERS_COUNT; i++) {
+        self->callback_descriptors[i].is_queued = false;
+    }
+}
+
+#else
 
 static inline void call_subs(
     struct ZtlDigitalInput* const self,
-    struct ZtlDigitalInputCallbackDescriptor const* const cb_descr,
-    enum ZtlDigitalInputEventType const event)
+    struct ZtlDigitalInputCallbackDescriptor* const cb_descr,
+    enum ZtlDigitalInputEventType const event,
+    uint64_t const now)
 {
     k_mutex_unlock(&g_inputs_mutex);
+#if defined(CONFIG_ZTL_INSTRUMENTATION)
+    uint32_t const latency_us = (uint32_t)(ztl_time__now_us() - now);
+    uint32_t const start_cyc = k_cycle_get_32();
+#endif
     cb_descr->callback(event, cb_descr->arg);
-    k_mutex_lock(&g_inputs_mutex, K_FOREVER);
+#if defined(CONFIG_ZTL_INSTRUMENTATION)
+    record_callback(cb_descr, latency_us, k_cycle_get_32() - start_cyc);
+#endif
+    lock_inputs();
 }
 
-static void handle_input(struct ZtlDigitalInput* const self, uint64_t const now) {
-    bool const new_state = (bool)gpio_pin_get_dt(self->gpio);
-    self->tl_handling = now;
+#endif
+
+static void call_event_subs(struct ZtlDigitalInput* const self, enum ZtlDigitalInputEventType const event, uint64_t const now) {
+#if defined(CONFIG_ZTL_REFLEX)
+    // Raw edges of edge captured inputs already acted from the ISR
+    bool const is_raw = event <= ZTL_DIGITAL_INPUT_EVENT_TYPE__CHANGE_STATE_TO_INACTIVE;
+    if (self->reflexes && !(is_raw && self->is_edge_capture)) {
+        ztl_reflex__fire(self->reflexes, event, g_scan_cycles);
+    }
+#endif
+
+    // Copy, a callback may subscribe while the mutex is released
+    uint32_t subs = self->event_subs[event];
+    while (subs) {
+        uint8_t const i = (uint8_t)u32_count_trailing_zeros(subs);
+        subs &= subs - 1;
+        call_subs(self, &self->callback_descriptors[i], event, now);
+    }
+}
+
+static void process_input_debounced(struct ZtlDigitalInput* const self, bool const state, uint64_t const now) {
+    self->prev_state_debounced = state;
+    k_condvar_broadcast(&g_inputs_changed);
+    update_mask(g_scan_debounced_mask, self->index, state);
+    if (state) {
+        publish_flags(self, FLAG_STATE_DEBOUNCED | FLAG_CHANGED_DEBOUNCED | FLAG_CHANGED_DEBOUNCED_BUTTON, 0);
+    } else {
+        publish_flags(self, FLAG_CHANGED_DEBOUNCED | FLAG_CHANGED_DEBOUNCED_BUTTON, FLAG_STATE_DEBOUNCED);
+    }
+    call_event_subs(self, state ?
+        ZTL_DIGITAL_INPUT_EVENT_TYPE__CHANGE_STATE_TO_ACTIVE_DEBOUNCED :
+        ZTL_DIGITAL_INPUT_EVENT_TYPE__CHANGE_STATE_TO_INACTIVE_DEBOUNCED, now);
+}
+
+static void process_input(struct ZtlDigitalInput* const self, bool const new_state, uint64_t const now) {
     if (new_state != self->prev_state) {
         // Handle just state change
-        self->tl_state_change = now;
-        self->is_state_changed = true;
+        publish_state_change(self, new_state, now);
+#if defined(CONFIG_ZTL_INSTRUMENTATION)
+        self->edges++;
+#endif
         self->is_subs_called_for_duration = false;
-        // Call all subs on state change
-        for (uint8_t i = 0; i < CONFIG_ZTL_DIGITAL_INPUT_MAX_SUBSCRIBERS_COUNT; i++) {
-            struct ZtlDigitalInputCallbackDescriptor const* const cb_descr = &self->callback_descriptors[i];
-            if (cb_descr->callback) {
-                if (new_state && cb_descr->conditions.change_state_to_active) {
-                    call_subs(self, cb_descr, ZTL_DIGITAL_INPUT_EVENT_TYPE__CHANGE_STATE_TO_ACTIVE);
-                } else if (!new_state && cb_descr->conditions.change_state_to_inactive) {
-                    call_subs(self, cb_descr, ZTL_DIGITAL_INPUT_EVENT_TYPE__CHANGE_STATE_TO_INACTIVE);
-                }
-            }
-        }
+        call_event_subs(self, new_state ?
+            ZTL_DIGITAL_INPUT_EVENT_TYPE__CHANGE_STATE_TO_ACTIVE :
+            ZTL_DIGITAL_INPUT_EVENT_TYPE__CHANGE_STATE_TO_INACTIVE, now);
         self->prev_state = new_state;
+        k_condvar_broadcast(&g_inputs_changed);
     } else {
         // Handle debounced state change
-        uint64_t const level_duration = now - self->tl_state_change;
-        if (level_duration >= self->debounce_duration_ms) {
+        uint64_t const level_duration = now - ztl_time__expand_us(now, self->tl_state_change);
+        bool const is_time_debounce = ZTL_DIGITAL_INPUT_DEBOUNCE__TIME == self->debounce_mode;
+        if (is_time_debounce && level_duration >= self->debounce_duration_us) {
             if (self->prev_state_debounced != self->prev_state) {
-                self->prev_state_debounced = self->prev_state;
-                self->is_state_changed_debounced = true;
-                self->is_state_changed_debounced_button = true;
-                // Call all subs on debounced state change
-                for (uint8_t i = 0; i < CONFIG_ZTL_DIGITAL_INPUT_MAX_SUBSCRIBERS_COUNT; i++) {
-                    struct ZtlDigitalInputCallbackDescriptor const* const cb_descr = &self->callback_descriptors[i];
-                    if (cb_descr->callback) {
-                        if (self->prev_state && cb_descr->conditions.change_state_to_active_debounced) {
-                            call_subs(self, cb_descr, ZTL_DIGITAL_INPUT_EVENT_TYPE__CHANGE_STATE_TO_ACTIVE_DEBOUNCED);
-                        } else if (!self->prev_state && cb_descr->conditions.change_state_to_inactive_debounced) {
-                            call_subs(self, cb_descr, ZTL_DIGITAL_INPUT_EVENT_TYPE__CHANGE_STATE_TO_INACTIVE_DEBOUNCED);
-                        }
-                    }
-                }
-                self->prev_state_debounced = self->prev_state;
+#if defined(CONFIG_ZTL_INSTRUMENTATION)
+                self->debounce_error_last_us = (uint32_t)MIN(level_duration - self->debounce_duration_us, UINT32_MAX);
+                self->debounce_error_max_us = MAX(self->debounce_error_max_us, self->debounce_error_last_us);
+#endif
+                process_input_debounced(self, self->prev_state, now);
             }
         }
 
-        // Call all subs on state duration
-        for (uint8_t i = 0; i < CONFIG_ZTL_DIGITAL_INPUT_MAX_SUBSCRIBERS_COUNT; i++) {
-            struct ZtlDigitalInputCallbackDescriptor const* const cb_descr = &self->callback_descriptors[i];
-            if (cb_descr->callback) {
-                uint32_t const active_dur_cond = cb_descr->conditions.active_state_duration;
-                uint32_t const inactive_dur_cond = cb_descr->conditions.inactive_state_duration;
-                bool const is_active_duration_check = self->prev_state && active_dur_cond &&
-                    self->is_subs_called_for_duration;
-                bool const is_inactive_duration_check = !self->prev_state && inactive_dur_cond &&
-                    self->is_subs_called_for_duration;
-
-                if (is_active_duration_check && level_duration >= active_dur_cond) {
-                    call_subs(self, cb_descr, ZTL_DIGITAL_INPUT_EVENT_TYPE__ACTIVE_DURATION);
-                    self->is_subs_called_for_duration = true;
-                } else if (is_inactive_duration_check && level_duration >= inactive_dur_cond) {
-                    call_subs(self, cb_descr, ZTL_DIGITAL_INPUT_EVENT_TYPE__INACTIVE_DURATION);
+        // Call the first sub whose state duration is reached
+        uint32_t const min_ms = self->prev_state ? self->active_duration_min_ms : self->inactive_duration_min_ms;
+        bool const is_duration_check = min_ms && !self->is_subs_called_for_duration;
+        if (is_duration_check && level_duration >= (uint64_t)min_ms * USEC_PER_MSEC) {
+            enum ZtlDigitalInputEventType const event = self->prev_state ?
+                ZTL_DIGITAL_INPUT_EVENT_TYPE__ACTIVE_DURATION : ZTL_DIGITAL_INPUT_EVENT_TYPE__INACTIVE_DURATION;
+            uint32_t subs = self->event_subs[event];
+            while (subs) {
+                uint8_t const i = (uint8_t)u32_count_trailing_zeros(subs);
+                subs &= subs - 1;
+                struct ZtlDigitalInputCallbackDescriptor* const cb_descr = &self->callback_descriptors[i];
+                uint32_t const dur_cond = self->prev_state ?
+                    cb_descr->active_state_duration : cb_descr->inactive_state_duration;
+                if (level_duration >= (uint64_t)dur_cond * USEC_PER_MSEC) {
+                    call_subs(self, cb_descr, event, now);
                     self->is_subs_called_for_duration = true;
+                    break;
                 }
             }
         }
     }
 }
 
-static void input_handler(void* arg1, void* arg2, void* arg3) {
+#if defined(CONFIG_ZTL_DIGITAL_INPUT_EDGE_CAPTURE)
+
+static void input_edge_callback(struct device const* const port, struct gpio_callback* const cb, gpio_port_pins_t const pins) {
+#if defined(CONFIG_ZTL_REFLEX)
+    uint32_t const start_cyc = k_cycle_get_32();
+#endif
+    struct ZtlDigitalInput* const self = CONTAINER_OF(cb, struct ZtlDigitalInput, gpio_cb);
+    uint64_t const now = ztl_time__now_us();
+    bool const state = gpio_pin_get_dt(self->gpio) > 0;
+    bool is_wakeup = true;
+
+#if defined(CONFIG_ZTL_DIGITAL_INPUT_PULSE_CAPTURE)
+    struct ZtlDigitalInputCapture* const capture = self->capture;
+    if (capture) {
+        // Fast signals wake the handler once per batch, not once per edge.
+        // The first edge of a batch wakes it too, see capture_batch_deadline().
+        is_wakeup = ztl_digital_input_capture__push(capture, k_cycle_get_32(), state);
+    }
+#endif
+
+#if defined(CONFIG_ZTL_QUADRATURE)
+    struct ZtlQuadrature* const quadrature = self->quadrature;
+    if (quadrature) {
+        bool const is_a = &quadrature->a == self;
+        bool const other = gpio_pin_get_dt((is_a ? &quadrature->b : &quadrature->a)->gpio) > 0;
+        ztl_quadrature__update(quadrature, is_a ? state : other, is_a ? other : state);
+    }
+#endif
+
+    // Vertical counters take the level from the scans, bounces of these
+    // inputs only feed the consumers above and the reflexes
+    bool const is_scanned = ZTL_DIGITAL_INPUT_DEBOUNCE__VERTICAL_COUNTER == self->debounce_mode;
+
+    k_spinlock_key_t const key = k_spin_lock(&g_edges_lock);
+#if defined(CONFIG_ZTL_REFLEX)
+    // Under the lock, bindings are only attached and detached with it held
+    if (self->reflexes && state != self->edge_last_state) {
+        ztl_reflex__fire(self->reflexes, state ?
+            ZTL_DIGITAL_INPUT_EVENT_TYPE__CHANGE_STATE_TO_ACTIVE :
+            ZTL_DIGITAL_INPUT_EVENT_TYPE__CHANGE_STATE_TO_INACTIVE, start_cyc);
+    }
+#endif
+    self->edge_last_state = state;
+    if (!is_scanned) {
+        is_wakeup = is_wakeup || 0 == self->edge_count;
+        if (0 == self->edge_count) {
+            self->edge_first_state = state;
+            self->tl_edge_first = now;
+        }
+        self->tl_edge_last = now;
+        self->edge_count++;
+        g_edges_pending[self->index / 64] |= BIT64(self->index % 64);
+    }
+    k_spin_unlock(&g_edges_lock, key);
+
+    if (is_wakeup && !is_scanned) {
+        ztl_io_engine__wakeup(ZTL_IO_ENGINE_CLIENT__INPUTS);
+    }
+}
+
+static void handle_input_edges(struct ZtlDigitalInput* const self, uint64_t const now) {
+    k_spinlock_key_t const key = k_spin_lock(&g_edges_lock);
+    uint32_t const edge_count = self->edge_count;
+    bool const first_state = self->edge_first_state;
+    bool const last_state = self->edge_last_state;
+    uint64_t const tl_first = ztl_time__expand_us(now, self->tl_edge_first);
+    uint64_t const tl_last = ztl_time__expand_us(now, self->tl_edge_last);
+    self->edge_count = 0;
+    k_spin_unlock(&g_edges_lock, key);
+
+    self->tl_handling = now;
+    if (edge_count > 0) {
+        // A pulse shorter than the handler latency shows up as a first edge
+        // away from the known state followed by the edge back to it
+        process_input(self, first_state, tl_first);
+        process_input(self, last_state, tl_last);
+    }
+    process_input(self, self->prev_state, now);
+}
+
+static int configure_edge_capture(struct ZtlDigitalInput* const self, bool const enable) {
+    if (enable == self->is_edge_capture) {
+        return 0;
+    }
+
+    if (enable) {
+        int const rc = gpio_pin_interrupt_configure_dt(self->gpio, GPIO_INT_EDGE_BOTH);
+        if (-ENOTSUP == rc || -ENOSYS == rc) {
+            // Controller can't report edges, keep polling this input
+            return 0;
+        }
+        TRY(rc);
+        // Level the ISR compares the first edge with
+        self->edge_last_state = gpio_pin_get_dt(self->gpio) > 0;
+        gpio_init_callback(&self->gpio_cb, input_edge_callback, BIT(self->gpio->pin));
+        int const cb_rc = gpio_add_callback(self->gpio->port, &self->gpio_cb);
+        if (cb_rc < 0) {
+            // No handler for the interrupt, leave the pin polled
+            (void)gpio_pin_interrupt_configure_dt(self->gpio, GPIO_INT_DISABLE);
+            return cb_rc;
+        }
+        // Edges before this point were never captured, sync with the pin
+        process_input(self, gpio_pin_get_dt(self->gpio) > 0, ztl_time__now_us());
+    } else {
+        TRY(gpio_pin_interrupt_configure_dt(self->gpio, GPIO_INT_DISABLE));
+        TRY(gpio_remove_callback(self->gpio->port, &self->gpio_cb));
+    }
+    self->is_edge_capture = enable;
+
+    return 0;
+}
+
+#endif
+
+static void register_port(struct ZtlDigitalInput* const self) {
+    uint8_t idx = 0;
+    while (idx < g_ports_count && g_ports[idx].dev != self->gpio->port) {
+        idx++;
+    }
+    if (idx == g_ports_count) {
+        g_ports[idx].dev = self->gpio->port;
+        g_ports_count++;
+    }
+
+    if (self->gpio->dt_flags & GPIO_ACTIVE_LOW) {
+        g_ports[idx].active_low_mask |= BIT(self->gpio->pin);
+    } else {
+        g_ports[idx].active_low_mask &= ~BIT(self->gpio->pin);
+    }
+    self->port_idx = idx;
+}
+
+// Frees the port entry of an unregistered input unless another input
+// still reads that port
+static void unregister_port(struct ZtlDigitalInput* const self) {
+    uint8_t const idx = self->port_idx;
+    g_ports[idx].active_low_mask &= ~BIT(self->gpio->pin);
+    for (uint8_t i = 0; i < CONFIG_ZTL_DIGITAL_INPUT_MAX_COUNT; i++) {
+        if (g_inputs[i] && idx == g_inputs[i]->port_idx) {
+            return;
+        }
+    }
+
+    // The last entry moves into the hole
+    uint8_t const last = --g_ports_count;
+    if (idx != last) {
+        g_ports[idx] = g_ports[last];
+        for (uint8_t i = 0; i < CONFIG_ZTL_DIGITAL_INPUT_MAX_COUNT; i++) {
+            if (g_inputs[i] && last == g_inputs[i]->port_idx) {
+                g_inputs[i]->port_idx = idx;
+            }
+        }
+    }
+    memset(&g_ports[last], 0, sizeof(g_ports[last]));
+}
+
+static void configure_debounce_mode(struct ZtlDigitalInput* const self, enum ZtlDigitalInputDebounce const mode) {
+    struct InputPort* const port = &g_ports[self->port_idx];
+    gpio_port_pins_t const pin = BIT(self->gpio->pin);
+    if (ZTL_DIGITAL_INPUT_DEBOUNCE__VERTICAL_COUNTER == mode) {
+        // Counting starts from the current debounced state
+        ztl_vertical_debounce__reset(&port->vc, pin, self->prev_state_debounced ? pin : 0);
+        port->vc_mask |= pin;
+#if defined(CONFIG_ZTL_DIGITAL_INPUT_EDGE_CAPTURE)
+        // Edges recorded before are never handled in this mode
+        k_spinlock_key_t const key = k_spin_lock(&g_edges_lock);
+        self->edge_count = 0;
+        k_spin_unlock(&g_edges_lock, key);
+#endif
+    } else {
+        port->vc_mask &= ~pin;
+    }
+    self->debounce_mode = mode;
+}
+
+static void invalidate_ports(void) {
+    for (uint8_t i = 0; i < g_ports_count; i++) {
+        g_ports[i].is_sampled = false;
+        g_ports[i].is_vc_updated = false;
+    }
+}
+
+static int sample_input(struct ZtlDigitalInput const* const self, bool* const state) {
+    struct InputPort* const port = &g_ports[self->port_idx];
+    if (!port->is_sampled) {
+        TRY(gpio_port_get_raw(port->dev, &port->raw));
+        port->is_sampled = true;
+        if (port->vc_mask && !port->is_vc_updated) {
+            port->is_vc_updated = true;
+            uint32_t rising;
+            uint32_t falling;
+            ztl_vertical_debounce__update(&port->vc, port->raw ^ port->active_low_mask, &rising, &falling);
+        }
+    }
+    *state = 0 != ((port->raw ^ port->active_low_mask) & BIT(self->gpio->pin));
+
+    return 0;
+}
+
+static void handle_input(struct ZtlDigitalInput* const self, uint64_t const now) {
+    bool new_state = false;
+    TRY_PASS(sample_input(self, &new_state));
+    self->tl_handling = now;
+    process_input(self, new_state, now);
+
+#if defined(CONFIG_ZTL_QUADRATURE)
+    struct ZtlQuadrature* const quadrature = self->quadrature;
+    if (quadrature) {
+        // Both channels come from the same scan, so they are coherent when
+        // they share a port. Repeated samples decode as no movement.
+        bool a = false;
+        bool b = false;
+        TRY_PASS(sample_input(&quadrature->a, &a));
+        TRY_PASS(sample_input(&quadrature->b, &b));
+        ztl_quadrature__update(quadrature, a, b);
+    }
+#endif
+
+    if (ZTL_DIGITAL_INPUT_DEBOUNCE__VERTICAL_COUNTER == self->debounce_mode) {
+        bool const state_debounced = 0 != (g_ports[self->port_idx].vc.state & BIT(self->gpio->pin));
+        if (state_debounced != self->prev_state_debounced) {
+            process_input_debounced(self, state_debounced, now);
+        }
+    }
+}
+
+static bool is_input_polled(struct ZtlDigitalInput const* const self) {
+    // Vertical counters integrate one sample per scan, so they need the scans
+    if (ZTL_DIGITAL_INPUT_DEBOUNCE__VERTICAL_COUNTER == self->debounce_mode) {
+        return true;
+    }
+#if defined(CONFIG_ZTL_DIGITAL_INPUT_EDGE_CAPTURE)
+    return !self->is_edge_capture;
+#else
+    return true;
+#endif
+}
+
+#if defined(CONFIG_ZTL_DIGITAL_INPUT_PULSE_CAPTURE)
+// Edges of a captured input are handled once a batch is full, or a sample
+// period after the first edge of a burst that never fills it. UINT64_MAX
+// without pending edges.
+static uint64_t capture_batch_deadline(struct ZtlDigitalInput const* const self, uint64_t const now) {
+    uint64_t deadline = UINT64_MAX;
+    if (NULL == self->capture || is_input_polled(self)) {
+        return deadline;
+    }
+
+    k_spinlock_key_t const key = k_spin_lock(&g_edges_lock);
+    if (self->edge_count >= self->capture->batch) {
+        deadline = now;
+    } else if (self->edge_count > 0) {
+        deadline = ztl_time__expand_us(now, self->tl_edge_first) + self->sample_period_us;
+    }
+    k_spin_unlock(&g_edges_lock, key);
+
+    return deadline;
+}
+#endif
+
+static uint64_t input_next_deadline(struct ZtlDigitalInput const* const self, uint64_t const now) {
+    uint64_t deadline = UINT64_MAX;
+    uint64_t const tl_state_change = ztl_time__expand_us(now, self->tl_state_change);
+
+    bool const is_time_debounce = ZTL_DIGITAL_INPUT_DEBOUNCE__TIME == self->debounce_mode;
+    if (is_time_debounce && self->prev_state_debounced != self->prev_state) {
+        deadline = tl_state_change + self->debounce_duration_us;
+    }
+
+    uint32_t const min_ms = self->prev_state ? self->active_duration_min_ms : self->inactive_duration_min_ms;
+    if (min_ms && !self->is_subs_called_for_duration) {
+        deadline = MIN(deadline, tl_state_change + (uint64_t)min_ms * USEC_PER_MSEC);
+    }
+
+    return deadline;
+}
+
+static void heap_swap(uint8_t const a, uint8_t const b) {
+    struct ZtlDigitalInput* const tmp = g_deadline_heap[a];
+    g_deadline_heap[a] = g_deadline_heap[b];
+    g_deadline_heap[b] = tmp;
+    g_deadline_heap[a]->heap_idx = a;
+    g_deadline_heap[b]->heap_idx = b;
+}
+
+static void heap_sift_up(uint8_t idx) {
+    while (idx > 0) {
+        uint8_t const parent = (idx - 1) / 2;
+        if (!ztl_time__is_stamp_before(g_deadline_heap[idx]->tl_deadline, g_deadline_heap[parent]->tl_deadline)) {
+            break;
+        }
+        heap_swap(parent, idx);
+        idx = parent;
+    }
+}
+
+static void heap_sift_down(uint8_t idx) {
     while (true) {
-        k_mutex_lock(&g_inputs_mutex, K_FOREVER);
-        uint64_t const now = (uint64_t)k_uptime_get();
-        for (uint8_t i = 0; i < CONFIG_ZTL_DIGITAL_OUTPUT_MAX_COUNT; i++) {
-            if (g_inputs[i] && g_inputs[i]->tl_handling != now) {
-                handle_input(g_inputs[i], now);
+        uint8_t min = idx;
+        uint8_t const left = 2 * idx + 1;
+        uint8_t const right = left + 1;
+        if (left < g_deadline_heap_count && ztl_time__is_stamp_before(g_deadline_heap[left]->tl_deadline, g_deadline_heap[min]->tl_deadline)) {
+            min = left;
+        }
+        if (right < g_deadline_heap_count && ztl_time__is_stamp_before(g_deadline_heap[right]->tl_deadline, g_deadline_heap[min]->tl_deadline)) {
+            min = right;
+        }
+        if (min == idx) {
+            break;
+        }
+        heap_swap(min, idx);
+        idx = min;
+    }
+}
+
+static void heap_remove(struct ZtlDigitalInput* const self) {
+    uint8_t const idx = self->heap_idx;
+    if (HEAP_IDX_NONE == idx) {
+        return;
+    }
+    self->heap_idx = HEAP_IDX_NONE;
+    g_deadline_heap_count--;
+    if (idx != g_deadline_heap_count) {
+        g_deadline_heap[idx] = g_deadline_heap[g_deadline_heap_count];
+        g_deadline_heap[idx]->heap_idx = idx;
+        heap_sift_up(idx);
+        heap_sift_down(g_deadline_heap[idx]->heap_idx);
+    }
+}
+
+// Puts the input into the deadline heap at its next sample or deadline.
+// Call under g_inputs_mutex after anything that moves them.
+static void schedule_input(struct ZtlDigitalInput* const self, uint64_t const now) {
+    uint64_t deadline = input_next_deadline(self, now);
+    if (is_input_polled(self)) {
+        deadline = MIN(deadline, ztl_time__expand_us(now, self->tl_sample_next));
+    }
+#if defined(CONFIG_ZTL_DIGITAL_INPUT_PULSE_CAPTURE)
+    deadline = MIN(deadline, capture_batch_deadline(self, now));
+#endif
+
+    if (UINT64_MAX == deadline) {
+        heap_remove(self);
+        return;
+    }
+
+    self->tl_deadline = deadline;
+    if (HEAP_IDX_NONE == self->heap_idx) {
+        self->heap_idx = g_deadline_heap_count;
+        g_deadline_heap[g_deadline_heap_count++] = self;
+    }
+    heap_sift_up(self->heap_idx);
+    heap_sift_down(self->heap_idx);
+}
+
+static void handle_if_needed_at(struct ZtlDigitalInput* const self, uint64_t const now) {
+#if defined(CONFIG_ZTL_DIGITAL_INPUT_EDGE_CAPTURE)
+    if (self->is_edge_capture && !is_input_polled(self)) {
+        handle_input_edges(self, now);
+        return;
+    }
+#endif
+    if (now >= ztl_time__expand_us(now, self->tl_sample_next)) {
+        if (self->tl_handling != (ztl_stamp_t)now) {
+            handle_input(self, now);
+        }
+        // Stay on the sampling grid, skip the samples missed while late
+        self->tl_sample_next += self->sample_period_us;
+        if (!ztl_time__is_stamp_before((ztl_stamp_t)now, self->tl_sample_next)) {
+#if defined(CONFIG_ZTL_INSTRUMENTATION)
+            g_engine_stats.missed_deadlines++;
+#endif
+            self->tl_sample_next = now + self->sample_period_us;
+        }
+    } else if (input_next_deadline(self, now) <= now) {
+        // Not due for a sample, expire debounce and duration with the last one
+        process_input(self, self->prev_state, now);
+    }
+}
+
+// A callback run without g_inputs_mutex may deinit an input of the pass
+static inline bool is_registered(struct ZtlDigitalInput const* const self) {
+    return self == g_inputs[self->index];
+}
+
+uint64_t ztl_digital_input__engine_pass(void) {
+    struct ZtlDigitalInput* due[CONFIG_ZTL_DIGITAL_INPUT_MAX_COUNT];
+    uint8_t due_count = 0;
+
+    lock_inputs();
+    uint64_t const now = ztl_time__now_us();
+#if defined(CONFIG_ZTL_INSTRUMENTATION)
+    uint32_t const start_cyc = k_cycle_get_32();
+    ztl_instrument__pass_begin(&g_engine_stats, now, g_engine_scheduled_us);
+#endif
+    invalidate_ports();
+#if defined(CONFIG_ZTL_SHIFT_REGISTER)
+    // One SPI frame per shift-register chain for the whole scan
+    ztl_shift_register__batch_begin();
+#endif
+#if defined(CONFIG_ZTL_REFLEX)
+    g_scan_cycles = k_cycle_get_32();
+#endif
+
+#if defined(CONFIG_ZTL_DIGITAL_INPUT_EDGE_CAPTURE)
+    uint64_t edges[ZTL_DIGITAL_INPUT_BANK_COUNT];
+    k_spinlock_key_t const key = k_spin_lock(&g_edges_lock);
+    memcpy(edges, g_edges_pending, sizeof(edges));
+    memset(g_edges_pending, 0, sizeof(g_edges_pending));
+    k_spin_unlock(&g_edges_lock, key);
+
+    for (uint8_t bank = 0; bank < ZTL_DIGITAL_INPUT_BANK_COUNT; bank++) {
+        while (edges[bank]) {
+            uint8_t const i = (uint8_t)(bank * 64 + u64_count_trailing_zeros(edges[bank]));
+            edges[bank] &= edges[bank] - 1;
+            if (g_inputs[i]) {
+                heap_remove(g_inputs[i]);
+                due[due_count++] = g_inputs[i];
             }
         }
-        k_mutex_unlock(&g_inputs_mutex);
-        k_usleep(THREAD_LOOP_SLEEP_US);
     }
+#endif
+
+    // Only the inputs whose sample or deadline is due are touched
+    while (g_deadline_heap_count > 0 && !ztl_time__is_stamp_before((ztl_stamp_t)now, g_deadline_heap[0]->tl_deadline)) {
+        due[due_count++] = g_deadline_heap[0];
+        heap_remove(g_deadline_heap[0]);
+    }
+    for (uint8_t i = 0; i < due_count; i++) {
+        if (!is_registered(due[i])) {
+            continue;
+        }
+#if defined(CONFIG_ZTL_DIGITAL_INPUT_PULSE_CAPTURE)
+        // Woken by the first edge of a capture batch, wait for it to fill
+        uint64_t const batch_deadline = capture_batch_deadline(due[i], now);
+        if (UINT64_MAX != batch_deadline && now < batch_deadline && now < input_next_deadline(due[i], now)) {
+            continue;
+        }
+#endif
+        handle_if_needed_at(due[i], now);
+    }
+    for (uint8_t i = 0; i < due_count; i++) {
+        if (is_registered(due[i])) {
+            schedule_input(due[i], now);
+        }
+    }
+    publish_masks();
+#if defined(CONFIG_ZTL_SHIFT_REGISTER)
+    (void)ztl_shift_register__batch_end();
+#endif
+
+    // Next pass at the earliest sample or deadline, or on the next edge
+    uint64_t deadline = UINT64_MAX;
+    if (g_deadline_heap_count > 0) {
+        deadline = ztl_time__expand_us(now, g_deadline_heap[0]->tl_deadline);
+    }
+#if defined(CONFIG_ZTL_INSTRUMENTATION)
+    g_engine_scheduled_us = deadline;
+    ztl_instrument__pass_end(&g_engine_stats, start_cyc);
+#endif
+    k_mutex_unlock(&g_inputs_mutex);
+
+    return deadline;
 }
 
 static void handle_if_needed(struct ZtlDigitalInput* const self) {
-    uint64_t const now = (uint64_t)k_uptime_get();
-    if (self->tl_handling != now) {
-        handle_input(self, now);
+    uint64_t const now = ztl_time__now_us();
+    if (self->tl_handling != (ztl_stamp_t)now) {
+        // Query from an application thread, take a fresh port snapshot. The
+        // debounce time of vertical counters must not depend on queries.
+        g_ports[self->port_idx].is_sampled = false;
+        g_ports[self->port_idx].is_vc_updated = true;
+    }
+#if defined(CONFIG_ZTL_SHIFT_REGISTER)
+    ztl_shift_register__batch_begin();
+#endif
+#if defined(CONFIG_ZTL_REFLEX)
+    g_scan_cycles = k_cycle_get_32();
+#endif
+    handle_if_needed_at(self, now);
+    schedule_input(self, now);
+    publish_masks();
+#if defined(CONFIG_ZTL_SHIFT_REGISTER)
+    (void)ztl_shift_register__batch_end();
+#endif
+}
+
+static int wait_any_state(
+    struct ZtlDigitalInput* const* const inputs,
+    uint8_t const count,
+    bool const is_debounced,
+    bool const state,
+    k_timeout_t const timeout,
+    uint8_t* const index)
+{
+    int rc = 0;
+    ASSERT(NULL != inputs, ER_INVAL);
+    ASSERT(count > 0, ER_INVAL);
+
+    for (uint8_t i = 0; i < count; i++) {
+        ASSERT(NULL != inputs[i], ER_INVAL);
+    }
+
+    k_timepoint_t const end = sys_timepoint_calc(timeout);
+
+    lock_inputs();
+
+    for (uint8_t i = 0; i < count; i++) {
+        handle_if_needed(inputs[i]);
+    }
+
+    // The input handler broadcasts every state change, no polling here
+    while (true) {
+        for (uint8_t i = 0; i < count; i++) {
+            bool const input_state = is_debounced ? inputs[i]->prev_state_debounced : inputs[i]->prev_state;
+            if (state == input_state) {
+                if (index) {
+                    *index = i;
+                }
+                rc = 0;
+                goto finally;
+            }
+        }
+        TRY_EX(k_condvar_wait(&g_inputs_changed, &g_inputs_mutex, sys_timepoint_timeout(end)));
+    }
+
+ finally:
+
+    k_mutex_unlock(&g_inputs_mutex);
+
+    return rc;
+}
+
+// Takes slot index of g_inputs with default settings. Call under g_inputs_mutex.
+static int register_input(
+    struct ZtlDigitalInput* const self,
+    struct gpio_dt_spec const* const gpio,
+    uint8_t const index,
+    gpio_flags_t const extra_flags)
+{
+    g_inputs[index] = self;
+    memset(self, 0, sizeof(*self));
+    self->index = index;
+    self->gpio = gpio;
+    self->debounce_duration_us = DEFAULT_DEBOUNCE_DURATION_MS * USEC_PER_MSEC;
+    self->sample_period_us = CONFIG_ZTL_DIGITAL_INPUT_SAMPLE_PERIOD_US;
+    self->heap_idx = HEAP_IDX_NONE;
+    // Compact stamps only resolve near now, zero is not a valid "long ago"
+    self->tl_state_change = ztl_time__now_us();
+    self->tl_sample_next = self->tl_state_change;
+    // GPIO_ACTIVE_HIGH is 0, so the level comes from the DT flags
+    if (self->gpio->dt_flags & GPIO_ACTIVE_LOW) {
+        self->active_level = ZTL_LEVEL__LOW;
+    } else {
+        self->active_level = ZTL_LEVEL__HIGH;
+    }
+    register_port(self);
+    TRY(gpio_pin_configure_dt(self->gpio, GPIO_INPUT | extra_flags));
+
+    return 0;
+}
+
+// Gives slot index of g_inputs back and detaches everything bound to the
+// input. Call under g_inputs_mutex.
+static int unregister_input(struct ZtlDigitalInput* const self) {
+#if defined(CONFIG_ZTL_DIGITAL_INPUT_EDGE_CAPTURE)
+    TRY(configure_edge_capture(self, false));
+    k_spinlock_key_t const key = k_spin_lock(&g_edges_lock);
+    g_edges_pending[self->index / 64] &= ~BIT64(self->index % 64);
+    self->edge_count = 0;
+#endif
+#if defined(CONFIG_ZTL_REFLEX)
+    while (self->reflexes) {
+        struct ZtlReflex* const reflex = self->reflexes;
+        self->reflexes = reflex->next;
+        reflex->next = NULL;
+    }
+#endif
+#if defined(CONFIG_ZTL_DIGITAL_INPUT_EDGE_CAPTURE)
+    k_spin_unlock(&g_edges_lock, key);
+#endif
+#if defined(CONFIG_ZTL_DIGITAL_INPUT_PULSE_CAPTURE)
+    self->capture = NULL;
+#endif
+#if defined(CONFIG_ZTL_QUADRATURE)
+    self->quadrature = NULL;
+#endif
+#if defined(CONFIG_ZTL_DIGITAL_INPUT_DEFERRED_DISPATCH)
+    drop_dispatch_records(self);
+#endif
+    heap_remove(self);
+    configure_debounce_mode(self, ZTL_DIGITAL_INPUT_DEBOUNCE__TIME);
+    g_inputs[self->index] = NULL;
+    unregister_port(self);
+    update_mask(g_scan_raw_mask, self->index, false);
+    update_mask(g_scan_debounced_mask, self->index, false);
+    publish_masks();
+
+    return 0;
+}
+
+#if DT_HAS_COMPAT_STATUS_OKAY(ztl_digital_input)
+
+// Settings of a ztl,digital-input node, kept in flash
+typedef struct InputConfig {
+    struct gpio_dt_spec gpio;
+    gpio_flags_t pull_flags;
+    uint32_t debounce_duration_us;
+    uint32_t clump_duration_us;
+    uint32_t sample_period_us;
+    bool is_vertical_counter;
+    bool is_edge_capture;
+} InputConfig;
+
+#define INPUT_DT_PULL_FLAGS(node_id)                                                  \
+    (ZTL_DIGITAL_INPUT_PULL__UP == DT_ENUM_IDX(node_id, pull) ? GPIO_PULL_UP :        \
+     ZTL_DIGITAL_INPUT_PULL__DOWN == DT_ENUM_IDX(node_id, pull) ? GPIO_PULL_DOWN : 0)
+
+#define INPUT_DT_CONFIG(node_id)                                                      \
+    {                                                                                 \
+        .gpio = GPIO_DT_SPEC_GET(node_id, gpios),                                     \
+        .pull_flags = INPUT_DT_PULL_FLAGS(node_id),                                   \
+        .debounce_duration_us = DT_PROP(node_id, debounce_us),                        \
+        .clump_duration_us = DT_PROP(node_id, clump_us),                              \
+        .sample_period_us = DT_PROP(node_id, sample_period_us),                       \
+        .is_vertical_counter = DT_PROP(node_id, vertical_counter),                    \
+        .is_edge_capture = DT_PROP(node_id, edge_capture),                            \
+    },
+
+#define INPUT_DT_DEFINE(node_id) struct ZtlDigitalInput ZTL_DIGITAL_INPUT_DT_NAME(node_id);
+#define INPUT_DT_REF(node_id) &ZTL_DIGITAL_INPUT_DT_NAME(node_id),
+
+DT_FOREACH_STATUS_OKAY(ztl_digital_input, INPUT_DT_DEFINE)
+
+static struct InputConfig const g_dt_configs[] = {
+    DT_FOREACH_STATUS_OKAY(ztl_digital_input, INPUT_DT_CONFIG)
+};
+static struct ZtlDigitalInput* const g_dt_inputs[] = {
+    DT_FOREACH_STATUS_OKAY(ztl_digital_input, INPUT_DT_REF)
+};
+
+BUILD_ASSERT(ARRAY_SIZE(g_dt_configs) <= CONFIG_ZTL_DIGITAL_INPUT_MAX_COUNT, "Too many ztl,digital-input nodes");
+
+// DT inputs take the first slots in node order, their pins are unique by
+// construction so there is no duplicate scan
+static int init_dt_inputs(void) {
+    int rc = 0;
+
+    lock_inputs();
+
+    for (uint8_t i = 0; i < ARRAY_SIZE(g_dt_configs); i++) {
+        struct InputConfig const* const config = &g_dt_configs[i];
+        struct ZtlDigitalInput* const self = g_dt_inputs[i];
+
+        TRY_EX(register_input(self, &config->gpio, i, config->pull_flags));
+        self->debounce_duration_us = config->debounce_duration_us;
+        self->clump_duration_us = config->clump_duration_us;
+        if (config->sample_period_us) {
+            self->sample_period_us = config->sample_period_us;
+        }
+        if (config->is_vertical_counter) {
+            configure_debounce_mode(self, ZTL_DIGITAL_INPUT_DEBOUNCE__VERTICAL_COUNTER);
+        }
+#if defined(CONFIG_ZTL_DIGITAL_INPUT_EDGE_CAPTURE)
+        if (config->is_edge_capture || IS_ENABLED(CONFIG_ZTL_DIGITAL_INPUT_EDGE_CAPTURE_DEFAULT)) {
+            TRY_EX(configure_edge_capture(self, true));
+        }
+#endif
+        schedule_input(self, ztl_time__now_us());
     }
+
+ finally:
+
+    k_mutex_unlock(&g_inputs_mutex);
+    ztl_io_engine__wakeup(ZTL_IO_ENGINE_CLIENT__INPUTS);
+
+    if (rc < 0) {
+        LOG_ERR("DT input init failed: %d", rc);
+    }
+
+    return rc;
 }
 
+SYS_INIT(init_dt_inputs, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
+
+#endif
+
 int ztl_digital_input__init(struct ZtlDigitalInput* const self, struct gpio_dt_spec const* gpio) {
     int rc = ER_NO_MEM;
 
     ASSERT(NULL != self, ER_INVAL);
     ASSERT(NULL != gpio, ER_INVAL);
 
-    k_mutex_lock(&g_inputs_mutex, K_FOREVER);
+    lock_inputs();
 
     for (uint8_t i = 0; i < CONFIG_ZTL_DIGITAL_INPUT_MAX_COUNT; i++) {
         if (g_inputs[i]) {
@@ -134,25 +1126,39 @@ int ztl_digital_input__init(struct ZtlDigitalInput* const self, struct gpio_dt_s
         }
     }
 
-    for (int i = 0; i < CONFIG_ZTL_DIGITAL_INPUT_MAX_COUNT; i++) {
+    for (uint8_t i = 0; i < CONFIG_ZTL_DIGITAL_INPUT_MAX_COUNT; i++) {
         if (NULL == g_inputs[i]) {
-            gpio_flags_t gpio_cfg = 0;
-            g_inputs[i] = self;
-            memset(self, 0, sizeof(*self));
-            self->gpio = gpio;
-            self->debounce_duration_ms = DEFAULT_DEBOUNCE_DURATION_MS;
-            TRY_EX(gpio_pin_get_config_dt(self->gpio, &gpio_cfg));
-            if (gpio_cfg & GPIO_ACTIVE_HIGH) {
-                self->active_level = ZTL_LEVEL__HIGH;
-            } else {
-                self->active_level = ZTL_LEVEL__LOW;
+            TRY_EX(register_input(self, gpio, i, 0));
+#if defined(CONFIG_ZTL_DIGITAL_INPUT_EDGE_CAPTURE_DEFAULT)
+            int const capture_rc = configure_edge_capture(self, true);
+            if (capture_rc < 0) {
+                (void)unregister_input(self);
+                rc = capture_rc;
+                goto finally;
             }
-            TRY_EX(gpio_pin_configure_dt(self->gpio, GPIO_INPUT));
+#endif
+            schedule_input(self, ztl_time__now_us());
             rc = 0;
             break;
         }
     }
 
+ finally:
+
+    k_mutex_unlock(&g_inputs_mutex);
+    ztl_io_engine__wakeup(ZTL_IO_ENGINE_CLIENT__INPUTS);
+
+    return rc;
+}
+
+int ztl_digital_input__deinit(struct ZtlDigitalInput* const self) {
+    int rc = 0;
+    ASSERT(NULL != self, ER_INVAL);
+
+    lock_inputs();
+    ASSERT_EX(self->index < CONFIG_ZTL_DIGITAL_INPUT_MAX_COUNT && self == g_inputs[self->index], ER_INVAL);
+    TRY_EX(unregister_input(self));
+
  finally:
 
     k_mutex_unlock(&g_inputs_mutex);
@@ -164,29 +1170,29 @@ int ztl_digital_input__state(struct ZtlDigitalInput* self, bool* state) {
     ASSERT(NULL != self, ER_INVAL);
     ASSERT(NULL != state, ER_INVAL);
 
-    k_mutex_lock(&g_inputs_mutex, K_FOREVER);
-    handle_if_needed(self);
-    *state = self->prev_state;
-    k_mutex_unlock(&g_inputs_mutex);
+    *state = 0 != (atomic_get(&self->flags) & FLAG_STATE);
 
     return 0;
 }
 
 int ztl_digital_input__wait_state(struct ZtlDigitalInput* self, bool const state) {
+    return ztl_digital_input__wait_state_timeout(self, state, K_FOREVER);
+}
+
+int ztl_digital_input__wait_state_timeout(struct ZtlDigitalInput* self, bool const state, k_timeout_t const timeout) {
     ASSERT(NULL != self, ER_INVAL);
 
-    while (true) {
-        k_mutex_lock(&g_inputs_mutex, K_FOREVER);
-        handle_if_needed(self);
-        if (state == self->prev_state) {
-            k_mutex_unlock(&g_inputs_mutex);
-            break;
-        }
-        k_mutex_unlock(&g_inputs_mutex);
-        k_usleep(THREAD_LOOP_SLEEP_US);
-    }
+    return wait_any_state(&self, 1, false, state, timeout, NULL);
+}
 
-    return 0;
+int ztl_digital_input__wait_any_state(
+    struct ZtlDigitalInput* const* inputs,
+    uint8_t count,
+    bool state,
+    k_timeout_t timeout,
+    uint8_t* index)
+{
+    return wait_any_state(inputs, count, false, state, timeout, index);
 }
 
 int ztl_digital_input__is_state_changed(struct ZtlDigitalInput* self, bool* is_changed, bool* state) {
@@ -194,26 +1200,34 @@ int ztl_digital_input__is_state_changed(struct ZtlDigitalInput* self, bool* is_c
     ASSERT(NULL != is_changed, ER_INVAL);
     ASSERT(NULL != state, ER_INVAL);
 
-    k_mutex_lock(&g_inputs_mutex, K_FOREVER);
-    handle_if_needed(self);
-    *is_changed = self->is_state_changed;
-    self->is_state_changed = false;
-    *state = self->prev_state;
-    k_mutex_unlock(&g_inputs_mutex);
+    atomic_val_t const flags = atomic_and(&self->flags, ~FLAG_CHANGED);
+    *is_changed = 0 != (flags & FLAG_CHANGED);
+    *state = 0 != (flags & FLAG_STATE);
 
     return 0;
 }
 
 int ztl_digital_input__state_duration(struct ZtlDigitalInput* const self, bool* state, uint64_t* duration_ms) {
+    ASSERT(NULL != duration_ms, ER_INVAL);
+
+    uint64_t duration_us = 0;
+    TRY(ztl_digital_input__state_duration_us(self, state, &duration_us));
+    *duration_ms = duration_us / USEC_PER_MSEC;
+
+    return 0;
+}
+
+int ztl_digital_input__state_duration_us(struct ZtlDigitalInput* const self, bool* state, uint64_t* duration_us) {
     ASSERT(NULL != self, ER_INVAL);
     ASSERT(NULL != state, ER_INVAL);
-    ASSERT(NULL != duration_ms, ER_INVAL);
+    ASSERT(NULL != duration_us, ER_INVAL);
 
-    k_mutex_lock(&g_inputs_mutex, K_FOREVER);
-    handle_if_needed(self);
-    *state = self->prev_state;
-    *duration_ms = (uint64_t)k_uptime_get() - self->tl_state_change;
-    k_mutex_unlock(&g_inputs_mutex);
+    atomic_val_t flags;
+    ztl_stamp_t tl_state_change;
+    read_snapshot(self, &flags, &tl_state_change);
+    uint64_t const now = ztl_time__now_us();
+    *state = 0 != (flags & FLAG_STATE);
+    *duration_us = now - ztl_time__expand_us(now, tl_state_change);
 
     return 0;
 }
@@ -222,10 +1236,7 @@ int ztl_digital_input__state_debounced(struct ZtlDigitalInput* self, bool* state
     ASSERT(NULL != self, ER_INVAL);
     ASSERT(NULL != state, ER_INVAL);
 
-    k_mutex_lock(&g_inputs_mutex, K_FOREVER);
-    handle_if_needed(self);
-    *state = self->prev_state_debounced;
-    k_mutex_unlock(&g_inputs_mutex);
+    *state = 0 != (atomic_get(&self->flags) & FLAG_STATE_DEBOUNCED);
 
     return 0;
 }
@@ -236,39 +1247,44 @@ int ztl_digital_input__state_button(struct ZtlDigitalInput* self, enum ZtlButton
 
     *state = ZTL_BUTTON_STATE__NONE;
 
-    k_mutex_lock(&g_inputs_mutex, K_FOREVER);
-    handle_if_needed(self);
+    atomic_val_t flags;
+    ztl_stamp_t tl_state_change;
+    read_snapshot(self, &flags, &tl_state_change);
+    uint64_t const now = ztl_time__now_us();
+
+    bool const is_pushed = (flags & FLAG_STATE_DEBOUNCED) &&
+        (atomic_and(&self->flags, ~FLAG_CHANGED_DEBOUNCED_BUTTON) & FLAG_CHANGED_DEBOUNCED_BUTTON);
 
-    if (self->is_state_changed_debounced_button && self->prev_state_debounced) {
+    if (is_pushed) {
         *state = ZTL_BUTTON_STATE__PUSHED;
-        self->is_state_changed_debounced_button = false;
-    } else if (self->prev_state) {
-        uint64_t const state_dur = (uint64_t)k_uptime_get() - self->tl_state_change;
-        if (state_dur >= self->clump_duration_ms) {
+    } else if (flags & FLAG_STATE) {
+        uint64_t const state_dur = now - ztl_time__expand_us(now, tl_state_change);
+        if (state_dur >= self->clump_duration_us) {
             *state = ZTL_BUTTON_STATE__CLUMPED;
         }
     }
 
-    k_mutex_unlock(&g_inputs_mutex);
-
     return 0;
 }
 
 int ztl_digital_input__wait_state_debounced(struct ZtlDigitalInput* self, bool const state) {
+    return ztl_digital_input__wait_state_debounced_timeout(self, state, K_FOREVER);
+}
+
+int ztl_digital_input__wait_state_debounced_timeout(struct ZtlDigitalInput* self, bool const state, k_timeout_t const timeout) {
     ASSERT(NULL != self, ER_INVAL);
 
-    while (true) {
-        k_mutex_lock(&g_inputs_mutex, K_FOREVER);
-        handle_if_needed(self);
-        if (state == self->prev_state_debounced) {
-            k_mutex_unlock(&g_inputs_mutex);
-            break;
-        }
-        k_mutex_unlock(&g_inputs_mutex);
-        k_usleep(THREAD_LOOP_SLEEP_US);
-    }
+    return wait_any_state(&self, 1, true, state, timeout, NULL);
+}
 
-    return 0;
+int ztl_digital_input__wait_any_state_debounced(
+    struct ZtlDigitalInput* const* inputs,
+    uint8_t count,
+    bool state,
+    k_timeout_t timeout,
+    uint8_t* index)
+{
+    return wait_any_state(inputs, count, true, state, timeout, index);
 }
 
 int ztl_digital_input__is_state_changed_debounced(struct ZtlDigitalInput* self, bool* is_changed, bool* state) {
@@ -276,38 +1292,112 @@ int ztl_digital_input__is_state_changed_debounced(struct ZtlDigitalInput* self,
     ASSERT(NULL != is_changed, ER_INVAL);
     ASSERT(NULL != state, ER_INVAL);
 
-    k_mutex_lock(&g_inputs_mutex, K_FOREVER);
-    handle_if_needed(self);
-    *is_changed = self->is_state_changed_debounced;
-    self->is_state_changed_debounced = false;
-    *state = self->prev_state_debounced;
-    k_mutex_unlock(&g_inputs_mutex);
+    atomic_val_t const flags = atomic_and(&self->flags, ~FLAG_CHANGED_DEBOUNCED);
+    *is_changed = 0 != (flags & FLAG_CHANGED_DEBOUNCED);
+    *state = 0 != (flags & FLAG_STATE_DEBOUNCED);
+
+    return 0;
+}
+
+int ztl_digital_input__index(struct ZtlDigitalInput const* const self, uint8_t* const index) {
+    ASSERT(NULL != self, ER_INVAL);
+    ASSERT(NULL != index, ER_INVAL);
+
+    *index = self->index;
+
+    return 0;
+}
+
+int ztl_digital_input__snapshot(struct ZtlDigitalInputSnapshot* const snapshot) {
+    return ztl_digital_input__snapshot_bank(0, snapshot);
+}
+
+int ztl_digital_input__snapshot_bank(uint8_t const bank, struct ZtlDigitalInputSnapshot* const snapshot) {
+    ASSERT(bank < ZTL_DIGITAL_INPUT_BANK_COUNT, ER_INVAL);
+    ASSERT(NULL != snapshot, ER_INVAL);
+
+    k_spinlock_key_t const key = k_spin_lock(&g_publish_lock);
+    uint64_t const raw = g_raw_mask[bank];
+    uint64_t const debounced = g_debounced_mask[bank];
+    k_spin_unlock(&g_publish_lock, key);
+
+    snapshot->raw_changed = raw ^ snapshot->raw;
+    snapshot->debounced_changed = debounced ^ snapshot->debounced;
+    snapshot->raw = raw;
+    snapshot->debounced = debounced;
 
     return 0;
 }
 
 int ztl_digital_input__set_debounce_duration(struct ZtlDigitalInput* self, uint16_t ms) {
+    return ztl_digital_input__set_debounce_duration_us(self, (uint32_t)ms * USEC_PER_MSEC);
+}
+
+int ztl_digital_input__set_debounce_duration_us(struct ZtlDigitalInput* self, uint32_t us) {
     ASSERT(NULL != self, ER_INVAL);
-    ASSERT(ms > 0, ER_INVAL);
+    ASSERT(us > 0, ER_INVAL);
+#if defined(CONFIG_ZTL_COMPACT_LAYOUT)
+    ASSERT(us <= ZTL_TIME_STAMP_RANGE_US, ER_INVAL);
+#endif
+
+    lock_inputs();
+    self->debounce_duration_us = us;
+    schedule_input(self, ztl_time__now_us());
+    k_mutex_unlock(&g_inputs_mutex);
+    ztl_io_engine__wakeup(ZTL_IO_ENGINE_CLIENT__INPUTS);
 
-    k_mutex_lock(&g_inputs_mutex, K_FOREVER);
-    self->debounce_duration_ms = ms;
+    return 0;
+}
+
+int ztl_digital_input__set_debounce_mode(struct ZtlDigitalInput* const self, enum ZtlDigitalInputDebounce const mode) {
+    ASSERT(NULL != self, ER_INVAL);
+    ASSERT(ZTL_DIGITAL_INPUT_DEBOUNCE__TIME == mode || ZTL_DIGITAL_INPUT_DEBOUNCE__VERTICAL_COUNTER == mode, ER_INVAL);
+
+    lock_inputs();
+    configure_debounce_mode(self, mode);
+    schedule_input(self, ztl_time__now_us());
     k_mutex_unlock(&g_inputs_mutex);
+    ztl_io_engine__wakeup(ZTL_IO_ENGINE_CLIENT__INPUTS);
 
     return 0;
 }
 
 int ztl_digital_input__set_clump_duration(struct ZtlDigitalInput* self, uint16_t ms) {
+    return ztl_digital_input__set_clump_duration_us(self, (uint32_t)ms * USEC_PER_MSEC);
+}
+
+int ztl_digital_input__set_clump_duration_us(struct ZtlDigitalInput* self, uint32_t us) {
     ASSERT(NULL != self, ER_INVAL);
-    ASSERT(ms > 0, ER_INVAL);
+    ASSERT(us > 0, ER_INVAL);
 
-    k_mutex_lock(&g_inputs_mutex, K_FOREVER);
-    self->clump_duration_ms = ms;
+    lock_inputs();
+    self->clump_duration_us = us;
     k_mutex_unlock(&g_inputs_mutex);
 
     return 0;
 }
 
+int ztl_digital_input__set_sample_period_us(struct ZtlDigitalInput* const self, uint32_t const us) {
+    ASSERT(NULL != self, ER_INVAL);
+    ASSERT(us > 0, ER_INVAL);
+#if defined(CONFIG_ZTL_COMPACT_LAYOUT)
+    ASSERT(us <= ZTL_TIME_STAMP_RANGE_US, ER_INVAL);
+#endif
+
+    lock_inputs();
+    self->sample_period_us = us;
+    // A shorter period takes effect now, not after the old one ends
+    uint64_t const now = ztl_time__now_us();
+    if (ztl_time__is_stamp_before(now + us, self->tl_sample_next)) {
+        self->tl_sample_next = now + us;
+    }
+    schedule_input(self, now);
+    k_mutex_unlock(&g_inputs_mutex);
+    ztl_io_engine__wakeup(ZTL_IO_ENGINE_CLIENT__INPUTS);
+
+    return 0;
+}
+
 int ztl_digital_input__state_to_level(struct ZtlDigitalInput const* self, bool state, enum ZtlLevel* level) {
     ASSERT(NULL != self, ER_INVAL);
     ASSERT(NULL != level, ER_INVAL);
@@ -321,6 +1411,274 @@ int ztl_digital_input__state_to_level(struct ZtlDigitalInput const* self, bool s
     return 0;
 }
 
+#if defined(CONFIG_ZTL_DIGITAL_INPUT_EDGE_CAPTURE)
+int ztl_digital_input__set_edge_capture(struct ZtlDigitalInput* const self, bool const enable) {
+    int rc = 0;
+    ASSERT(NULL != self, ER_INVAL);
+
+    lock_inputs();
+    TRY_EX(configure_edge_capture(self, enable));
+    schedule_input(self, ztl_time__now_us());
+
+ finally:
+
+    k_mutex_unlock(&g_inputs_mutex);
+    ztl_io_engine__wakeup(ZTL_IO_ENGINE_CLIENT__INPUTS);
+
+    return rc;
+}
+#endif
+
+#if defined(CONFIG_ZTL_DIGITAL_INPUT_PULSE_CAPTURE)
+int ztl_digital_input__start_capture(struct ZtlDigitalInput* const self, struct ZtlDigitalInputCapture* const capture) {
+    int rc = 0;
+    ASSERT(NULL != self, ER_INVAL);
+    ASSERT(NULL != capture, ER_INVAL);
+
+    lock_inputs();
+    TRY_EX(configure_edge_capture(self, true));
+    // Controller without edge interrupts
+    ASSERT_EX(self->is_edge_capture, -ENOTSUP);
+    self->capture = capture;
+
+ finally:
+
+    k_mutex_unlock(&g_inputs_mutex);
+
+    return rc;
+}
+
+int ztl_digital_input__stop_capture(struct ZtlDigitalInput* const self) {
+    ASSERT(NULL != self, ER_INVAL);
+
+    lock_inputs();
+    self->capture = NULL;
+    k_mutex_unlock(&g_inputs_mutex);
+    ztl_io_engine__wakeup(ZTL_IO_ENGINE_CLIENT__INPUTS);
+
+    return 0;
+}
+#endif
+
+#if defined(CONFIG_ZTL_QUADRATURE)
+int ztl_digital_input__attach_quadrature(struct ZtlDigitalInput* const self, struct ZtlQuadrature* const quadrature) {
+    ASSERT(NULL != self, ER_INVAL);
+
+    lock_inputs();
+    self->quadrature = quadrature;
+    k_mutex_unlock(&g_inputs_mutex);
+
+    return 0;
+}
+#endif
+
+#if defined(CONFIG_ZTL_REFLEX)
+int ztl_digital_input__attach_reflex(struct ZtlDigitalInput* const self, struct ZtlReflex* const reflex) {
+    ASSERT(NULL != self, ER_INVAL);
+    ASSERT(NULL != reflex, ER_INVAL);
+
+    lock_inputs();
+#if defined(CONFIG_ZTL_DIGITAL_INPUT_EDGE_CAPTURE)
+    k_spinlock_key_t const key = k_spin_lock(&g_edges_lock);
+#endif
+    reflex->next = self->reflexes;
+    self->reflexes = reflex;
+#if defined(CONFIG_ZTL_DIGITAL_INPUT_EDGE_CAPTURE)
+    k_spin_unlock(&g_edges_lock, key);
+#endif
+    k_mutex_unlock(&g_inputs_mutex);
+
+    return 0;
+}
+
+int ztl_digital_input__detach_reflex(struct ZtlDigitalInput* const self, struct ZtlReflex* const reflex) {
+    int rc = ER_INVAL;
+    ASSERT(NULL != self, ER_INVAL);
+    ASSERT(NULL != reflex, ER_INVAL);
+
+    lock_inputs();
+#if defined(CONFIG_ZTL_DIGITAL_INPUT_EDGE_CAPTURE)
+    k_spinlock_key_t const key = k_spin_lock(&g_edges_lock);
+#endif
+    for (struct ZtlReflex** it = &self->reflexes; *it; it = &(*it)->next) {
+        if (reflex == *it) {
+            *it = reflex->next;
+            reflex->next = NULL;
+            rc = 0;
+            break;
+        }
+    }
+#if defined(CONFIG_ZTL_DIGITAL_INPUT_EDGE_CAPTURE)
+    k_spin_unlock(&g_edges_lock, key);
+#endif
+    k_mutex_unlock(&g_inputs_mutex);
+
+    return rc;
+}
+#endif
+
+#if defined(CONFIG_ZTL_DIGITAL_INPUT_DEFERRED_DISPATCH)
+int ztl_digital_input__set_subscriber_priority(
+    struct ZtlDigitalInput* const self,
+    ZtlDigitalInputCallback const cb,
+    enum ZtlDigitalInputPriority const priority)
+{
+    int rc = ER_INVAL;
+    ASSERT(NULL != self, ER_INVAL);
+    ASSERT(NULL != cb, ER_INVAL);
+    ASSERT(priority < ZTL_DIGITAL_INPUT_PRIORITY__COUNT, ER_INVAL);
+
+    lock_inputs();
+    for (uint8_t i = 0; i < CONFIG_ZTL_DIGITAL_INPUT_MAX_SUBSCRIBERS_COUNT; i++) {
+        if (cb == self->callback_descriptors[i].callback) {
+            self->callback_descriptors[i].priority = priority;
+            // Its queued record stays in the ring of the old priority
+            self->callback_descriptors[i].is_queued = false;
+            rc = 0;
+            break;
+        }
+    }
+    k_mutex_unlock(&g_inputs_mutex);
+
+    return rc;
+}
+
+int ztl_digital_input__set_dispatch_queue(struct k_work_q* const queue) {
+    lock_inputs();
+    g_dispatch_queue = queue;
+    k_mutex_unlock(&g_inputs_mutex);
+
+    return 0;
+}
+
+int ztl_digital_input__dispatch_stats(struct ZtlDigitalInputDispatchStats* const stats) {
+    ASSERT(NULL != stats, ER_INVAL);
+
+    stats->dispatched = (uint32_t)atomic_get(&g_dispatch_dispatched);
+    stats->coalesced = (uint32_t)atomic_get(&g_dispatch_coalesced);
+    stats->overflows = (uint32_t)atomic_get(&g_dispatch_overflows);
+
+    return 0;
+}
+
+uint64_t ztl_digital_input__event_timestamp(void) {
+    return g_dispatch_timestamp;
+}
+#endif
+
+// Moves subscriber slot i to the event masks of conditions and refreshes
+// the shortest durations
+static void index_subscriber(struct ZtlDigitalInput* const self, uint8_t const i, struct ZtlDigitalInputEventConditions const* const cond) {
+    bool const is_event[ZTL_DIGITAL_INPUT_EVENT_TYPE__COUNT] = {
+        [ZTL_DIGITAL_INPUT_EVENT_TYPE__CHANGE_STATE_TO_ACTIVE] = cond->change_state_to_active,
+        [ZTL_DIGITAL_INPUT_EVENT_TYPE__CHANGE_STATE_TO_INACTIVE] = cond->change_state_to_inactive,
+        [ZTL_DIGITAL_INPUT_EVENT_TYPE__CHANGE_STATE_TO_ACTIVE_DEBOUNCED] = cond->change_state_to_active_debounced,
+        [ZTL_DIGITAL_INPUT_EVENT_TYPE__CHANGE_STATE_TO_INACTIVE_DEBOUNCED] = cond->change_state_to_inactive_debounced,
+        [ZTL_DIGITAL_INPUT_EVENT_TYPE__ACTIVE_DURATION] = cond->active_state_duration > 0,
+        [ZTL_DIGITAL_INPUT_EVENT_TYPE__INACTIVE_DURATION] = cond->inactive_state_duration > 0,
+    };
+    for (uint8_t event = 0; event < ZTL_DIGITAL_INPUT_EVENT_TYPE__COUNT; event++) {
+        if (is_event[event]) {
+            self->event_subs[event] |= BIT(i);
+        } else {
+            self->event_subs[event] &= ~BIT(i);
+        }
+    }
+
+    self->active_duration_min_ms = 0;
+    self->inactive_duration_min_ms = 0;
+    for (uint8_t j = 0; j < CONFIG_ZTL_DIGITAL_INPUT_MAX_SUBSCRIBERS_COUNT; j++) {
+        struct ZtlDigitalInputCallbackDescriptor const* const cb_descr = &self->callback_descriptors[j];
+        if (self->event_subs[ZTL_DIGITAL_INPUT_EVENT_TYPE__ACTIVE_DURATION] & BIT(j)) {
+            self->active_duration_min_ms = self->active_duration_min_ms ?
+                MIN(self->active_duration_min_ms, cb_descr->active_state_duration) : cb_descr->active_state_duration;
+        }
+        if (self->event_subs[ZTL_DIGITAL_INPUT_EVENT_TYPE__INACTIVE_DURATION] & BIT(j)) {
+            self->inactive_duration_min_ms = self->inactive_duration_min_ms ?
+                MIN(self->inactive_duration_min_ms, cb_descr->inactive_state_duration) : cb_descr->inactive_state_duration;
+        }
+    }
+}
+
+#if defined(CONFIG_ZTL_INSTRUMENTATION)
+int ztl_digital_input__engine_stats(struct ZtlInstrumentEngineStats* const stats) {
+    ASSERT(NULL != stats, ER_INVAL);
+
+    lock_inputs();
+    *stats = g_engine_stats;
+    k_mutex_unlock(&g_inputs_mutex);
+
+    return 0;
+}
+
+int ztl_digital_input__stats(struct ZtlDigitalInput* const self, struct ZtlDigitalInputStats* const stats) {
+    ASSERT(NULL != self, ER_INVAL);
+    ASSERT(NULL != stats, ER_INVAL);
+
+    memset(stats, 0, sizeof(*stats));
+
+    lock_inputs();
+    uint64_t const now = ztl_time__now_us();
+    stats->gpio = self->gpio;
+    stats->edges = self->edges;
+    stats->debounce_error_last_us = self->debounce_error_last_us;
+    stats->debounce_error_max_us = self->debounce_error_max_us;
+    if (now > self->tl_edges_query) {
+        uint64_t const edges = self->edges - self->edges_at_query;
+        stats->edges_per_sec = (uint32_t)(edges * USEC_PER_SEC / (now - self->tl_edges_query));
+    }
+    self->edges_at_query = self->edges;
+    self->tl_edges_query = now;
+
+    for (uint8_t i = 0; i < CONFIG_ZTL_DIGITAL_INPUT_MAX_SUBSCRIBERS_COUNT; i++) {
+        struct ZtlDigitalInputCallbackDescriptor const* const cb_descr = &self->callback_descriptors[i];
+        stats->subscribers[i] = (struct ZtlDigitalInputSubscriberStats){
+            .callback = cb_descr->callback,
+            .calls = cb_descr->calls,
+            .latency_last_us = cb_descr->latency_last_us,
+            .latency_max_us = cb_descr->latency_max_us,
+            .last_us = k_cyc_to_us_ceil32(cb_descr->callback_last_cyc),
+            .max_us = k_cyc_to_us_ceil32(cb_descr->callback_max_cyc),
+        };
+    }
+    k_mutex_unlock(&g_inputs_mutex);
+
+    return 0;
+}
+
+int ztl_digital_input__get(uint8_t const index, struct ZtlDigitalInput** const input) {
+    ASSERT(index < CONFIG_ZTL_DIGITAL_INPUT_MAX_COUNT, ER_INVAL);
+    ASSERT(NULL != input, ER_INVAL);
+
+    lock_inputs();
+    *input = g_inputs[index];
+    k_mutex_unlock(&g_inputs_mutex);
+
+    return 0;
+}
+
+int ztl_digital_input__reset_stats(void) {
+    lock_inputs();
+    memset(&g_engine_stats, 0, sizeof(g_engine_stats));
+    for (uint8_t i = 0; i < CONFIG_ZTL_DIGITAL_INPUT_MAX_COUNT; i++) {
+        struct ZtlDigitalInput* const self = g_inputs[i];
+        if (NULL == self) {
+            continue;
+        }
+        self->edges = 0;
+        self->edges_at_query = 0;
+        self->debounce_error_last_us = 0;
+        self->debounce_error_max_us = 0;
+        for (uint8_t j = 0; j < CONFIG_ZTL_DIGITAL_INPUT_MAX_SUBSCRIBERS_COUNT; j++) {
+            reset_callback_stats(&self->callback_descriptors[j]);
+        }
+    }
+    k_mutex_unlock(&g_inputs_mutex);
+
+    return 0;
+}
+#endif
+
 int ztl_digital_input__subscribe(
     struct ZtlDigitalInput* const self,
     struct ZtlDigitalInputEventConditions const* const conditions,
@@ -330,24 +1688,40 @@ int ztl_digital_input__subscribe(
     int rc = 0;
     ASSERT(NULL != self, ER_INVAL);
     ASSERT(NULL != conditions, ER_INVAL);
+#if defined(CONFIG_ZTL_COMPACT_LAYOUT)
+    ASSERT(conditions->active_state_duration <= ZTL_DIGITAL_INPUT_DURATION_MAX_MS, ER_INVAL);
+    ASSERT(conditions->inactive_state_duration <= ZTL_DIGITAL_INPUT_DURATION_MAX_MS, ER_INVAL);
+#endif
     bool is_found_free = false;
 
-    k_mutex_lock(&g_inputs_mutex, K_FOREVER);
+    lock_inputs();
     for (uint8_t i = 0; i < CONFIG_ZTL_DIGITAL_INPUT_MAX_SUBSCRIBERS_COUNT; i++) {
-        if (NULL == self->callback_descriptors[i].callback || cb == self->callback_descriptors[i].callback) {
-            self->callback_descriptors[i].callback = cb;
-            self->callback_descriptors[i].conditions = *conditions;
-            self->callback_descriptors[i].arg = arg;
+        struct ZtlDigitalInputCallbackDescriptor* const cb_descr = &self->callback_descriptors[i];
+        if (NULL == cb_descr->callback || cb == cb_descr->callback) {
+#if defined(CONFIG_ZTL_INSTRUMENTATION)
+            if (cb != cb_descr->callback) {
+                // Worst cases of a former subscriber of the slot don't apply
+                reset_callback_stats(cb_descr);
+            }
+#endif
+            cb_descr->callback = cb;
+            cb_descr->active_state_duration = conditions->active_state_duration;
+            cb_descr->inactive_state_duration = conditions->inactive_state_duration;
+            cb_descr->arg = arg;
+            index_subscriber(self, i, conditions);
             is_found_free = true;
             break;
         }
     }
 
     ASSERT_EX(is_found_free, ER_NO_MEM);
+    schedule_input(self, ztl_time__now_us());
 
  finally:
 
     k_mutex_unlock(&g_inputs_mutex);
+    // New duration conditions may need an earlier wakeup
+    ztl_io_engine__wakeup(ZTL_IO_ENGINE_CLIENT__INPUTS);
 
     return rc;
 }
@@ -408,3 +1782,15 @@ int ztl_digital_input__subscribe_to_state_duration(
 
     return ztl_digital_input__subscribe(self, &cond, cb, arg);
 }
+
+#if defined(CONFIG_ZTL_FOOTPRINT_REPORT)
+// Sizes as absolute ELF symbols without storage, printed after the link
+GEN_ABS_SYM_BEGIN(ztl_digital_input_footprint)
+GEN_ABSOLUTE_SYM(ztl_sizeof_digital_input, sizeof(struct ZtlDigitalInput));
+GEN_ABSOLUTE_SYM(ztl_sizeof_digital_input_subscriber, sizeof(struct ZtlDigitalInputCallbackDescriptor));
+GEN_ABSOLUTE_SYM(ztl_sizeof_digital_input_tables, sizeof(g_inputs) + sizeof(g_ports) + sizeof(g_deadline_heap));
+#if defined(CONFIG_ZTL_DIGITAL_INPUT_DEFERRED_DISPATCH)
+GEN_ABSOLUTE_SYM(ztl_sizeof_digital_input_dispatch, sizeof(g_dispatch_rings));
+#endif
+GEN_ABS_SYM_END
+#endif
@@ -2,13 +2,27 @@
 #define ZTL_DIGITAL_INPUT_H_
 
 #include "digital_common.h"
+#include "time.h"
+
+#if defined(CONFIG_ZTL_DIGITAL_INPUT_PULSE_CAPTURE)
+#include "digital_input_capture.h"
+#endif
+
+#if defined(CONFIG_ZTL_INSTRUMENTATION)
+#include "instrument.h"
+#endif
 
 #include <zephyr/drivers/gpio.h>
 #include <zephyr/devicetree.h>
 #include <zephyr/autoconf.h>
+#include <zephyr/kernel.h>
+#include <zephyr/sys/atomic.h>
 #include <zephyr/sys/mutex.h>
 #include <zephyr/types.h>
 
+struct ZtlQuadrature;
+struct ZtlReflex;
+
 typedef enum ZtlDigitalInputPull {
     ZTL_DIGITAL_INPUT_PULL__NONE = 0,
     ZTL_DIGITAL_INPUT_PULL__UP = 1,
@@ -22,14 +36,36 @@ typedef enum ZtlDigitalInputEventType {
     ZTL_DIGITAL_INPUT_EVENT_TYPE__CHANGE_STATE_TO_INACTIVE_DEBOUNCED,
     ZTL_DIGITAL_INPUT_EVENT_TYPE__ACTIVE_DURATION,
     ZTL_DIGITAL_INPUT_EVENT_TYPE__INACTIVE_DURATION,
+    ZTL_DIGITAL_INPUT_EVENT_TYPE__COUNT,
 } ZtlDigitalInputEventType;
 
+typedef enum ZtlDigitalInputDebounce {
+    // Debounced once the level is stable for debounce_duration_us
+    ZTL_DIGITAL_INPUT_DEBOUNCE__TIME = 0,
+    // Debounced after 4 consecutive equal scans, port-wide bitwise counters
+    ZTL_DIGITAL_INPUT_DEBOUNCE__VERTICAL_COUNTER = 1,
+} ZtlDigitalInputDebounce;
+
 typedef enum ZtlButtonState {
     ZTL_BUTTON_STATE__NONE = 0,
     ZTL_BUTTON_STATE__PUSHED = 1,
     ZTL_BUTTON_STATE__CLUMPED = 2,
 } ZtlButtonState;
 
+typedef enum ZtlDigitalInputPriority {
+    ZTL_DIGITAL_INPUT_PRIORITY__NORMAL = 0,
+    ZTL_DIGITAL_INPUT_PRIORITY__HIGH = 1,
+    ZTL_DIGITAL_INPUT_PRIORITY__COUNT,
+} ZtlDigitalInputPriority;
+
+// Duration conditions in milliseconds must fit the stamp range of the layout
+#if defined(CONFIG_ZTL_COMPACT_LAYOUT)
+#define ZTL_DIGITAL_INPUT_DURATION_MAX_MS (ZTL_TIME_STAMP_RANGE_US / USEC_PER_MSEC)
+#else
+#define ZTL_DIGITAL_INPUT_DURATION_MAX_MS UINT32_MAX
+#endif
+#define ZTL_DURATION_BITS 22
+
 typedef void (*ZtlDigitalInputCallback)(enum ZtlDigitalInputEventType, void*);
 
 typedef struct ZtlDigitalInputEventConditions {
@@ -41,41 +77,241 @@ typedef struct ZtlDigitalInputEventConditions {
     uint32_t inactive_state_duration;
 } ZtlDigitalInputEventConditions;
 
+// Edge conditions of a subscriber are kept in ZtlDigitalInput::event_subs,
+// the slot holds what is needed to call it
 typedef struct ZtlDigitalInputCallbackDescriptor {
     ZtlDigitalInputCallback callback;
-    struct ZtlDigitalInputEventConditions conditions;
     void* arg;
+    uint32_t active_state_duration ZTL_BITS(ZTL_DURATION_BITS);
+    uint32_t inactive_state_duration ZTL_BITS(ZTL_DURATION_BITS);
+#if defined(CONFIG_ZTL_DIGITAL_INPUT_DEFERRED_DISPATCH)
+    enum ZtlDigitalInputPriority priority ZTL_BITS(2);
+    // Last record queued for this subscriber and not delivered yet, a new
+    // event equal to it only moves its timestamp
+    bool is_queued ZTL_BITS(1);
+    enum ZtlDigitalInputEventType queued_event ZTL_BITS(3);
+    uint32_t queued_pos;
+#endif
+#if defined(CONFIG_ZTL_INSTRUMENTATION)
+    uint32_t calls;
+    // From the event timestamp to the callback start
+    uint32_t latency_last_us;
+    uint32_t latency_max_us;
+    uint32_t callback_last_cyc;
+    uint32_t callback_max_cyc;
+#endif
 } ZtlButtonCallbackDescriptor;
 
+typedef struct ZtlDigitalInputDispatchStats {
+    uint32_t dispatched;
+    uint32_t coalesced;
+    uint32_t overflows;
+} ZtlDigitalInputDispatchStats;
+
+#if defined(CONFIG_ZTL_INSTRUMENTATION)
+typedef struct ZtlDigitalInputSubscriberStats {
+    ZtlDigitalInputCallback callback;
+    uint32_t calls;
+    // From the event timestamp, the edge ISR or the scan that saw it, to the callback start
+    uint32_t latency_last_us;
+    uint32_t latency_max_us;
+    // Time spent in the callback
+    uint32_t last_us;
+    uint32_t max_us;
+} ZtlDigitalInputSubscriberStats;
+
+typedef struct ZtlDigitalInputStats {
+    struct gpio_dt_spec const* gpio;
+    // Raw state changes handled by the engine
+    uint32_t edges;
+    // Over the time since the previous query of this input
+    uint32_t edges_per_sec;
+    // Debounced change past the debounce duration of the stable level
+    uint32_t debounce_error_last_us;
+    uint32_t debounce_error_max_us;
+    struct ZtlDigitalInputSubscriberStats subscribers[CONFIG_ZTL_DIGITAL_INPUT_MAX_SUBSCRIBERS_COUNT];
+} ZtlDigitalInputStats;
+#endif
+
+// Members read on every scan come first, settings and subscribers after them
 typedef struct ZtlDigitalInput {
     struct gpio_dt_spec const* gpio;
-    uint16_t debounce_duration_ms;
-    uint16_t clump_duration_ms;
-    enum ZtlLevel active_level;
+    // Bit index % 64 of ZtlDigitalInputSnapshot masks of bank index / 64
+    uint8_t index;
+    // Index of the input port in the port snapshot table
+    uint8_t port_idx;
+    // Position in the engine deadline heap
+    uint8_t heap_idx;
+    // Owned by the input engine under g_inputs_mutex
+    bool prev_state ZTL_BITS(1);
+    bool prev_state_debounced ZTL_BITS(1);
+    bool is_subs_called_for_duration ZTL_BITS(1);
+    bool is_edge_capture ZTL_BITS(1);
+    enum ZtlDigitalInputDebounce debounce_mode ZTL_BITS(1);
+    // Timestamps are microseconds of ztl_time__now_us()
+    ztl_stamp_t tl_deadline;
+    ztl_stamp_t tl_sample_next;
+    ztl_stamp_t tl_state_change;
+    ztl_stamp_t tl_handling;
+    // State published by the input engine, queries read it without g_inputs_mutex.
+    // seq is odd while tl_state_change and flags are being updated.
+    atomic_t flags;
+    atomic_t seq;
+    uint32_t sample_period_us;
+    uint32_t debounce_duration_us;
+    // Shortest duration condition of the subscribers, 0 when there is none
+    uint32_t active_duration_min_ms;
+    uint32_t inactive_duration_min_ms;
+    // Subscribers by event type, bit N is callback_descriptors[N]
+    uint16_t event_subs[ZTL_DIGITAL_INPUT_EVENT_TYPE__COUNT];
+
+#if defined(CONFIG_ZTL_DIGITAL_INPUT_EDGE_CAPTURE)
+    // Edges captured in the GPIO callback and not yet handled, under g_edges_lock.
+    // Not packed with the engine bits above, the ISR writes them concurrently.
+    bool edge_first_state;
+    bool edge_last_state;
+    uint32_t edge_count;
+    ztl_stamp_t tl_edge_first;
+    ztl_stamp_t tl_edge_last;
+    struct gpio_callback gpio_cb;
+#endif
+
+    uint32_t clump_duration_us;
+    enum ZtlLevel active_level ZTL_BITS(1);
     struct ZtlDigitalInputCallbackDescriptor callback_descriptors[CONFIG_ZTL_DIGITAL_INPUT_MAX_SUBSCRIBERS_COUNT];
 
-    bool prev_state;
-    bool prev_state_debounced;
-    bool is_state_changed;
-    bool is_state_changed_debounced;
-    bool is_state_changed_debounced_button;
-    uint64_t tl_state_change;
-    uint64_t tl_handling;
-    bool is_subs_called_for_duration;
+#if defined(CONFIG_ZTL_DIGITAL_INPUT_PULSE_CAPTURE)
+    // Edge timestamp ring, NULL when capture is off
+    struct ZtlDigitalInputCapture* capture;
+#endif
+
+#if defined(CONFIG_ZTL_QUADRATURE)
+    // Encoder this input is a channel of, NULL otherwise
+    struct ZtlQuadrature* quadrature;
+#endif
+#if defined(CONFIG_ZTL_REFLEX)
+    // Output actions bound to edge events, see reflex.h
+    struct ZtlReflex* reflexes;
+#endif
+#if defined(CONFIG_ZTL_INSTRUMENTATION)
+    uint32_t edges;
+    uint32_t debounce_error_last_us;
+    uint32_t debounce_error_max_us;
+    // Edge count and time of the previous stats query
+    uint32_t edges_at_query;
+    uint64_t tl_edges_query;
+#endif
 } ZtlDigitalInput;
 
+enum {
+    // Snapshot banks of 64 inputs
+    ZTL_DIGITAL_INPUT_BANK_COUNT = DIV_ROUND_UP(CONFIG_ZTL_DIGITAL_INPUT_MAX_COUNT, 64),
+};
+
+// States of a bank of registered inputs, bit N is the input with index
+// 64 * bank + N. The changed masks hold the bits that differ from the
+// previous snapshot taken into the same struct, zero it before the first call.
+typedef struct ZtlDigitalInputSnapshot {
+    uint64_t raw;
+    uint64_t debounced;
+    uint64_t raw_changed;
+    uint64_t debounced_changed;
+} ZtlDigitalInputSnapshot;
+
+// Inputs of enabled ztl,digital-input nodes are allocated and registered
+// before main(), ZTL_DIGITAL_INPUT_DT_GET() returns one of them
+#define ZTL_DIGITAL_INPUT_DT_NAME(node_id) UTIL_CAT(ztl_digital_input_, DT_DEP_ORD(node_id))
+#define ZTL_DIGITAL_INPUT_DT_GET(node_id) (&ZTL_DIGITAL_INPUT_DT_NAME(node_id))
+#define ZTL_DIGITAL_INPUT_DT_DECLARE(node_id) extern struct ZtlDigitalInput ZTL_DIGITAL_INPUT_DT_NAME(node_id);
+
+DT_FOREACH_STATUS_OKAY(ztl_digital_input, ZTL_DIGITAL_INPUT_DT_DECLARE)
+
 int ztl_digital_input__init(struct ZtlDigitalInput* self, struct gpio_dt_spec const* gpio);
+// Frees the slot of the input. Its subscribers are not called any more,
+// events still queued for them are dropped, and reflexes, capture and
+// quadrature are detached.
+int ztl_digital_input__deinit(struct ZtlDigitalInput* self);
 int ztl_digital_input__state(struct ZtlDigitalInput* self, bool* state);
 int ztl_digital_input__wait_state(struct ZtlDigitalInput* self, bool state);
+int ztl_digital_input__wait_state_timeout(struct ZtlDigitalInput* self, bool state, k_timeout_t timeout);
 int ztl_digital_input__is_state_changed(struct ZtlDigitalInput* self, bool* is_changed, bool* state);
 int ztl_digital_input__state_duration(struct ZtlDigitalInput* const self, bool* state, uint64_t* duration_ms);
+int ztl_digital_input__state_duration_us(struct ZtlDigitalInput* const self, bool* state, uint64_t* duration_us);
 int ztl_digital_input__state_debounced(struct ZtlDigitalInput* self, bool* state);
 int ztl_digital_input__state_button(struct ZtlDigitalInput* self, enum ZtlButtonState* state);
 int ztl_digital_input__wait_state_debounced(struct ZtlDigitalInput* self, bool state);
+int ztl_digital_input__wait_state_debounced_timeout(struct ZtlDigitalInput* self, bool state, k_timeout_t timeout);
 int ztl_digital_input__is_state_changed_debounced(struct ZtlDigitalInput* self, bool* is_changed, bool* state);
 int ztl_digital_input__set_debounce_duration(struct ZtlDigitalInput* self, uint16_t ms);
+int ztl_digital_input__set_debounce_duration_us(struct ZtlDigitalInput* self, uint32_t us);
+int ztl_digital_input__set_debounce_mode(struct ZtlDigitalInput* self, enum ZtlDigitalInputDebounce mode);
 int ztl_digital_input__set_clump_duration(struct ZtlDigitalInput* self, uint16_t ms);
+int ztl_digital_input__set_clump_duration_us(struct ZtlDigitalInput* self, uint32_t us);
+int ztl_digital_input__set_sample_period_us(struct ZtlDigitalInput* self, uint32_t us);
+// Waits until any of the inputs is in the state, index receives the first one found.
+// Returns -EAGAIN on timeout.
+int ztl_digital_input__wait_any_state(
+    struct ZtlDigitalInput* const* inputs,
+    uint8_t count,
+    bool state,
+    k_timeout_t timeout,
+    uint8_t* index);
+int ztl_digital_input__wait_any_state_debounced(
+    struct ZtlDigitalInput* const* inputs,
+    uint8_t count,
+    bool state,
+    k_timeout_t timeout,
+    uint8_t* index);
 int ztl_digital_input__state_to_level(struct ZtlDigitalInput const* self, bool state, enum ZtlLevel* level);
+int ztl_digital_input__index(struct ZtlDigitalInput const* self, uint8_t* index);
+// Snapshot of bank 0, inputs 0 to 63
+int ztl_digital_input__snapshot(struct ZtlDigitalInputSnapshot* snapshot);
+// Each bank is consistent on its own, banks taken one after the other may be a scan apart
+int ztl_digital_input__snapshot_bank(uint8_t bank, struct ZtlDigitalInputSnapshot* snapshot);
+
+#if defined(CONFIG_ZTL_DIGITAL_INPUT_EDGE_CAPTURE)
+int ztl_digital_input__set_edge_capture(struct ZtlDigitalInput* self, bool enable);
+#endif
+
+#if defined(CONFIG_ZTL_DIGITAL_INPUT_PULSE_CAPTURE)
+// Records edge timestamps of the input into capture, which must be set up
+// with ztl_digital_input_capture__init() first. Enables edge capture.
+int ztl_digital_input__start_capture(struct ZtlDigitalInput* self, struct ZtlDigitalInputCapture* capture);
+int ztl_digital_input__stop_capture(struct ZtlDigitalInput* self);
+#endif
+
+#if defined(CONFIG_ZTL_QUADRATURE)
+// Used by ztl_quadrature__init(), feeds every sample of the input to the encoder
+int ztl_digital_input__attach_quadrature(struct ZtlDigitalInput* self, struct ZtlQuadrature* quadrature);
+#endif
+
+#if defined(CONFIG_ZTL_REFLEX)
+// Used by ztl_reflex__bind() and ztl_reflex__unbind()
+int ztl_digital_input__attach_reflex(struct ZtlDigitalInput* self, struct ZtlReflex* reflex);
+int ztl_digital_input__detach_reflex(struct ZtlDigitalInput* self, struct ZtlReflex* reflex);
+#endif
+
+#if defined(CONFIG_ZTL_DIGITAL_INPUT_DEFERRED_DISPATCH)
+int ztl_digital_input__set_subscriber_priority(
+    struct ZtlDigitalInput* self,
+    ZtlDigitalInputCallback cb,
+    enum ZtlDigitalInputPriority priority);
+// Callbacks run from this queue, the system work queue when NULL
+int ztl_digital_input__set_dispatch_queue(struct k_work_q* queue);
+int ztl_digital_input__dispatch_stats(struct ZtlDigitalInputDispatchStats* stats);
+// Timestamp in microseconds of the event being delivered, valid inside a callback only
+uint64_t ztl_digital_input__event_timestamp(void);
+#endif
+
+#if defined(CONFIG_ZTL_INSTRUMENTATION)
+int ztl_digital_input__engine_stats(struct ZtlInstrumentEngineStats* stats);
+int ztl_digital_input__stats(struct ZtlDigitalInput* self, struct ZtlDigitalInputStats* stats);
+// Input registered in slot index, NULL for a free slot. Walks all inputs
+// from 0 to CONFIG_ZTL_DIGITAL_INPUT_MAX_COUNT - 1.
+int ztl_digital_input__get(uint8_t index, struct ZtlDigitalInput** input);
+// Clears the engine figures, the worst cases of the subscribers and the edge counts
+int ztl_digital_input__reset_stats(void);
+#endif
 
 int ztl_digital_input__subscribe(
     struct ZtlDigitalInput* self,
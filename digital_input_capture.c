@@ -0,0 +1,118 @@
+#include "digital_input_capture.h"
+
+#include <lib/safe-c/safe_c.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/toolchain.h>
+
+BUILD_ASSERT(IS_POWER_OF_TWO(ZTL_DIGITAL_INPUT_CAPTURE_SIZE), "Capture ring size must be a power of two");
+
+// Moving average over the window: avg += (x - avg) / window
+static inline void average(int64_t* const avg, uint32_t const value, uint16_t const window) {
+    if (0 == *avg) {
+        *avg = value;
+    } else {
+        *avg += ((int64_t)value - *avg) / window;
+    }
+}
+
+static void process_stamp(struct ZtlDigitalInputCapture* const self, uint32_t const stamp) {
+    bool const state = stamp & 1U;
+    uint32_t const cycles = stamp & ~1U;
+
+    self->edges++;
+    if (state) {
+        if (self->has_rise) {
+            // Unsigned difference stays right across a counter wrap
+            average(&self->period_avg_cyc, cycles - self->last_rise, self->window);
+        }
+        self->last_rise = cycles;
+        self->has_rise = true;
+    } else {
+        if (self->has_rise) {
+            average(&self->high_avg_cyc, cycles - self->last_rise, self->window);
+        }
+    }
+}
+
+int ztl_digital_input_capture__init(struct ZtlDigitalInputCapture* const self, uint16_t const batch, uint16_t const window) {
+    ASSERT(NULL != self, ER_INVAL);
+    ASSERT(batch > 0 && batch <= ZTL_DIGITAL_INPUT_CAPTURE_SIZE, ER_INVAL);
+    ASSERT(window > 0, ER_INVAL);
+
+    memset(self, 0, sizeof(*self));
+    self->batch = batch;
+    self->window = window;
+    k_sem_init(&self->ready, 0, 1);
+
+    return 0;
+}
+
+int ztl_digital_input_capture__wait(struct ZtlDigitalInputCapture* const self, k_timeout_t const timeout) {
+    ASSERT(NULL != self, ER_INVAL);
+
+    if (atomic_get(&self->head) - atomic_get(&self->tail) >= self->batch) {
+        return 0;
+    }
+
+    return k_sem_take(&self->ready, timeout);
+}
+
+int ztl_digital_input_capture__drain(
+    struct ZtlDigitalInputCapture* const self,
+    uint32_t* const stamps,
+    uint16_t const max,
+    uint16_t* const count)
+{
+    ASSERT(NULL != self, ER_INVAL);
+
+    uint16_t drained = 0;
+    atomic_val_t tail = atomic_get(&self->tail);
+    atomic_val_t const head = atomic_get(&self->head);
+
+    while (tail != head && (NULL == stamps || drained < max)) {
+        uint32_t const stamp = self->stamps[tail & (ZTL_DIGITAL_INPUT_CAPTURE_SIZE - 1)];
+        process_stamp(self, stamp);
+        if (stamps) {
+            stamps[drained] = stamp;
+        }
+        drained++;
+        tail++;
+    }
+    atomic_set(&self->tail, tail);
+
+    if (count) {
+        *count = drained;
+    }
+
+    return 0;
+}
+
+int ztl_digital_input_capture__measure(struct ZtlDigitalInputCapture* const self, struct ZtlDigitalInputMeasurement* const measurement) {
+    ASSERT(NULL != self, ER_INVAL);
+    ASSERT(NULL != measurement, ER_INVAL);
+
+    TRY(ztl_digital_input_capture__drain(self, NULL, 0, NULL));
+
+    memset(measurement, 0, sizeof(*measurement));
+    measurement->edges = self->edges;
+    measurement->overflows = (uint32_t)atomic_get(&self->overflows);
+
+    if (self->period_avg_cyc > 0) {
+        uint64_t const period_cyc = (uint64_t)self->period_avg_cyc;
+        measurement->period_us = (uint32_t)k_cyc_to_us_floor64(period_cyc);
+        measurement->frequency_millihz = (uint32_t)((uint64_t)sys_clock_hw_cycles_per_sec() * 1000U / period_cyc);
+        if (self->high_avg_cyc > 0) {
+            measurement->high_us = (uint32_t)k_cyc_to_us_floor64((uint64_t)self->high_avg_cyc);
+            measurement->duty_permille = (uint16_t)MIN(1000U, (uint64_t)self->high_avg_cyc * 1000U / period_cyc);
+        }
+    }
+
+    return 0;
+}
+
+#if defined(CONFIG_ZTL_FOOTPRINT_REPORT)
+GEN_ABS_SYM_BEGIN(ztl_digital_input_capture_footprint)
+GEN_ABSOLUTE_SYM(ztl_sizeof_digital_input_capture, sizeof(struct ZtlDigitalInputCapture));
+GEN_ABS_SYM_END
+#endif
@@ -0,0 +1,72 @@
+#ifndef ZTL_DIGITAL_INPUT_CAPTURE_H_
+#define ZTL_DIGITAL_INPUT_CAPTURE_H_
+
+#include <zephyr/autoconf.h>
+#include <zephyr/kernel.h>
+#include <zephyr/sys/atomic.h>
+#include <zephyr/types.h>
+
+enum {
+    ZTL_DIGITAL_INPUT_CAPTURE_SIZE = CONFIG_ZTL_DIGITAL_INPUT_PULSE_CAPTURE_SIZE,
+};
+
+// Edge timestamps of one input. The edge ISR is the only producer, one
+// consumer thread drains it in batches. Each stamp is the 32-bit hardware
+// cycle counter with bit 0 replaced by the input state after the edge.
+typedef struct ZtlDigitalInputCapture {
+    uint32_t stamps[ZTL_DIGITAL_INPUT_CAPTURE_SIZE];
+    atomic_t head;
+    atomic_t tail;
+    atomic_t overflows;
+    // Edges collected before the consumer and the input handler are woken
+    uint16_t batch;
+    struct k_sem ready;
+
+    // Measurement state, owned by the consumer
+    uint16_t window;
+    uint32_t edges;
+    uint32_t last_rise;
+    bool has_rise;
+    int64_t period_avg_cyc;
+    int64_t high_avg_cyc;
+} ZtlDigitalInputCapture;
+
+typedef struct ZtlDigitalInputMeasurement {
+    // Edges seen since the capture started, wraps around
+    uint32_t edges;
+    // Moving averages over the capture window, 0 until known
+    uint32_t period_us;
+    uint32_t high_us;
+    uint32_t frequency_millihz;
+    uint16_t duty_permille;
+    // Edges lost because the ring was full
+    uint32_t overflows;
+} ZtlDigitalInputMeasurement;
+
+// Called from the edge ISR, returns true once a batch is ready
+static inline bool ztl_digital_input_capture__push(struct ZtlDigitalInputCapture* const self, uint32_t const cycles, bool const state) {
+    atomic_val_t const head = atomic_get(&self->head);
+    atomic_val_t const fill = head - atomic_get(&self->tail);
+
+    if (fill >= ZTL_DIGITAL_INPUT_CAPTURE_SIZE) {
+        atomic_inc(&self->overflows);
+        return true;
+    }
+
+    self->stamps[head & (ZTL_DIGITAL_INPUT_CAPTURE_SIZE - 1)] = (cycles & ~1U) | (state ? 1U : 0U);
+    atomic_set(&self->head, head + 1);
+
+    if (fill + 1 >= self->batch) {
+        k_sem_give(&self->ready);
+        return true;
+    }
+
+    return false;
+}
+
+int ztl_digital_input_capture__init(struct ZtlDigitalInputCapture* self, uint16_t batch, uint16_t window);
+int ztl_digital_input_capture__wait(struct ZtlDigitalInputCapture* self, k_timeout_t timeout);
+int ztl_digital_input_capture__drain(struct ZtlDigitalInputCapture* self, uint32_t* stamps, uint16_t max, uint16_t* count);
+int ztl_digital_input_capture__measure(struct ZtlDigitalInputCapture* self, struct ZtlDigitalInputMeasurement* measurement);
+
+#endif // ZTL_DIGITAL_INPUT_CAPTURE_H_
@@ -1,75 +1,624 @@
 #include "digital_output.h"
+#include "io_engine.h"
 #include "time.h"
 
+#if defined(CONFIG_ZTL_REFLEX)
+#include "reflex.h"
+#endif
+
+#if defined(CONFIG_ZTL_SHIFT_REGISTER)
+#include "shift_register.h"
+#endif
+
 #include <lib/safe-c/safe_c.h>
 
+#include <zephyr/init.h>
 #include <zephyr/kernel.h>
+#include <zephyr/toolchain.h>
 #include <zephyr/autoconf.h>
 
 enum {
     DEFAULT_PULSE_PERIOD_MS = 500,
-    DEFAULT_BLINK_ON_MS = DEFAULT_PULSE_PERIOD_MS / 2,
-    THREAD_LOOP_SLEEP_MS = 1,
-    THREAD_STACK_SIZE = 512,
-    THREAD_PRIO = 3,
+    DEFAULT_PULSE_ON_MS = DEFAULT_PULSE_PERIOD_MS / 2,
 };
 
 LOG_MODULE_REGISTER(ztl_digital_output);
 
+typedef struct OutputPort {
+    struct device const* dev;
+    gpio_port_pins_t active_low_mask;
+    gpio_port_pins_t pending_mask;
+    gpio_port_value_t pending_value;
+} OutputPort;
+
 static struct ZtlDigitalOutput* g_outputs[CONFIG_ZTL_DIGITAL_OUTPUT_MAX_COUNT] = {0};
+// Ports of the registered outputs, pin changes are merged into one write per port
+static struct OutputPort g_ports[CONFIG_ZTL_DIGITAL_OUTPUT_MAX_COUNT] = {0};
+static uint8_t g_ports_count = 0;
 K_MUTEX_DEFINE(g_outputs_mutex);
+#if defined(CONFIG_ZTL_INSTRUMENTATION)
+// Under g_outputs_mutex
+static struct ZtlInstrumentEngineStats g_engine_stats = {0};
+static uint64_t g_engine_scheduled_us = UINT64_MAX;
+#endif
+
+static inline void lock_outputs(void) {
+#if defined(CONFIG_ZTL_INSTRUMENTATION)
+    ztl_instrument__lock(&g_outputs_mutex, &g_engine_stats);
+#else
+    k_mutex_lock(&g_outputs_mutex, K_FOREVER);
+#endif
+}
+
+static void register_port(struct ZtlDigitalOutput* const self) {
+    uint8_t idx = 0;
+    while (idx < g_ports_count && g_ports[idx].dev != self->gpio->port) {
+        idx++;
+    }
+    if (idx == g_ports_count) {
+        g_ports[idx].dev = self->gpio->port;
+        g_ports_count++;
+    }
+
+    if (self->gpio->dt_flags & GPIO_ACTIVE_LOW) {
+        g_ports[idx].active_low_mask |= BIT(self->gpio->pin);
+    } else {
+        g_ports[idx].active_low_mask &= ~BIT(self->gpio->pin);
+    }
+    self->port_idx = idx;
+}
+
+#if defined(CONFIG_ZTL_DIGITAL_OUTPUT_PWM)
+
+// Steady levels of a PWM driven pin are 0 % or 100 % duty
+static void set_pwm_level(struct ZtlDigitalOutput* const output, bool const state) {
+    uint32_t const period = output->pwm->period;
+    int const rc = pwm_set_dt(output->pwm, period, state ? period : 0);
+    if (rc < 0) {
+        LOG_ERR("PWM level set failed: %d", rc);
+    }
+    output->hw_state = state;
+}
+
+static bool start_pwm_pulse(struct ZtlDigitalOutput* const self, uint64_t const now) {
+    if (NULL == self->pwm || self->pulse_period_us > UINT32_MAX / NSEC_PER_USEC) {
+        return false;
+    }
+
+    // Stop in the middle of the last off phase, so handler latency of up
+    // to half of it neither cuts the last pulse nor starts an extra one
+    uint32_t const off_us = self->pulse_period_us - self->pulse_on_us;
+    uint64_t const train_us = (uint64_t)MAX(self->pulse_count - 1, 0) * self->pulse_period_us +
+        self->pulse_on_us + off_us / 2;
+#if defined(CONFIG_ZTL_COMPACT_LAYOUT)
+    if (self->pulse_count > 0 && train_us > ZTL_TIME_STAMP_RANGE_US) {
+        // The stop deadline doesn't fit a compact stamp, toggle in software
+        return false;
+    }
+#endif
 
-static void output_handler(void*, void*, void*);
+    if (pwm_set_dt(self->pwm, PWM_USEC(self->pulse_period_us), PWM_USEC(self->pulse_on_us)) < 0) {
+        // Fall back to software toggling
+        return false;
+    }
+
+    self->is_pwm_pulse = true;
+    if (self->pulse_count > 0) {
+        self->tl_pulse_next_us = now + train_us;
+    }
+
+    return true;
+}
 
-K_THREAD_DEFINE(output_handler_tid, THREAD_STACK_SIZE,
-                output_handler, NULL, NULL, NULL,
-                THREAD_PRIO, 0, 0);
+static void stop_pwm_pulse(struct ZtlDigitalOutput* const self) {
+    self->is_pwm_pulse = false;
+    set_pwm_level(self, self->state);
+}
+
+#endif
 
-static inline int set_output(struct ZtlDigitalOutput* const output, bool const state) {
+// Stages the pin change, it reaches the hardware on flush_outputs()
+static inline void set_output(struct ZtlDigitalOutput* const output, bool const state) {
+#if defined(CONFIG_ZTL_DIGITAL_OUTPUT_PWM)
+    if (output->pwm) {
+        if (state != output->hw_state) {
+            set_pwm_level(output, state);
+        }
+        return;
+    }
+#endif
     if (state != output->hw_state) {
+        struct OutputPort* const port = &g_ports[output->port_idx];
+        gpio_port_pins_t const pin = BIT(output->gpio->pin);
         output->hw_state = state;
-        TRY(gpio_pin_set_dt(output->gpio, output->hw_state));
+        port->pending_mask |= pin;
+        if (state != (0 != (port->active_low_mask & pin))) {
+            port->pending_value |= pin;
+        } else {
+            port->pending_value &= ~pin;
+        }
+    }
+}
+
+static int flush_outputs(void) {
+    int rc = 0;
+
+#if defined(CONFIG_ZTL_SHIFT_REGISTER)
+    // Ports of one shift-register chain go out in a single SPI frame
+    ztl_shift_register__batch_begin();
+#endif
+    for (uint8_t i = 0; i < g_ports_count; i++) {
+        struct OutputPort* const port = &g_ports[i];
+        if (port->pending_mask) {
+            int const port_rc = gpio_port_set_masked_raw(port->dev, port->pending_mask, port->pending_value);
+            port->pending_mask = 0;
+            if (port_rc < 0) {
+                rc = port_rc;
+            }
+        }
+    }
+#if defined(CONFIG_ZTL_SHIFT_REGISTER)
+    int const chain_rc = ztl_shift_register__batch_end();
+    if (chain_rc < 0) {
+        rc = chain_rc;
+    }
+#endif
+
+    return rc;
+}
+
+static void start_pulse(struct ZtlDigitalOutput* const self, int32_t const pulse_count, uint64_t const now) {
+    self->sequence = NULL;
+    self->pulse_count = pulse_count;
+    self->pulse_state = true;
+#if defined(CONFIG_ZTL_DIGITAL_OUTPUT_PWM)
+    if (start_pwm_pulse(self, now)) {
+        return;
+    }
+#endif
+    self->tl_pulse_next_us = now + self->pulse_on_us;
+    set_output(self, self->pulse_state);
+}
+
+static inline bool is_waveform_running(struct ZtlDigitalOutput const* const self) {
+    return 0 != self->pulse_count || NULL != self->sequence;
+}
+
+// Ends a pulse train or a sequence, the output goes back to its set state
+static void stop_waveform(struct ZtlDigitalOutput* const self) {
+    self->pulse_count = 0;
+    self->sequence = NULL;
+#if defined(CONFIG_ZTL_DIGITAL_OUTPUT_PWM)
+    if (self->is_pwm_pulse) {
+        stop_pwm_pulse(self);
+    }
+#endif
+    set_output(self, self->state);
+}
+
+static inline uint16_t sequence_length(struct ZtlDigitalOutputSequence const* const seq) {
+    return seq->segments ? seq->segment_count : seq->bit_count;
+}
+
+static inline void sequence_step(
+    struct ZtlDigitalOutputSequence const* const seq,
+    uint16_t const idx,
+    bool* const level,
+    uint32_t* const duration_us)
+{
+    if (seq->segments) {
+        *level = seq->segments[idx].level;
+        *duration_us = seq->segments[idx].duration_us;
+    } else {
+        *level = 0 != (seq->pattern[idx / 32] & BIT(idx % 32));
+        *duration_us = seq->bit_period_us;
+    }
+}
+
+static void start_sequence(
+    struct ZtlDigitalOutput* const self,
+    struct ZtlDigitalOutputSequence const* const seq,
+    int32_t const loop_count,
+    uint64_t const now)
+{
+    bool level;
+    uint32_t duration_us;
+
+    stop_waveform(self);
+    self->sequence = seq;
+    self->sequence_idx = 0;
+    self->sequence_loops = loop_count;
+    sequence_step(seq, 0, &level, &duration_us);
+    self->tl_pulse_next_us = now + duration_us;
+    set_output(self, level);
+}
+
+static void handle_sequence(struct ZtlDigitalOutput* const self, uint64_t const now, uint64_t* const deadline) {
+    struct ZtlDigitalOutputSequence const* const seq = self->sequence;
+    uint16_t const length = sequence_length(seq);
+    bool level = self->hw_state;
+    uint32_t duration_us;
+
+    // Same absolute scheduling as pulse trains, every output started from
+    // one timestamp stays phase-locked to the others
+    while (now >= ztl_time__expand_us(now, self->tl_pulse_next_us)) {
+        self->sequence_idx++;
+        if (self->sequence_idx == length) {
+            self->sequence_idx = 0;
+            if (self->sequence_loops > 0) {
+                self->sequence_loops--;
+                if (0 == self->sequence_loops) {
+                    self->sequence = NULL;
+                    set_output(self, self->state);
+                    return;
+                }
+            }
+        }
+        sequence_step(seq, self->sequence_idx, &level, &duration_us);
+        self->tl_pulse_next_us += duration_us;
+    }
+
+    set_output(self, level);
+    *deadline = MIN(*deadline, ztl_time__expand_us(now, self->tl_pulse_next_us));
+}
+
+static int check_sequence(struct ZtlDigitalOutputSequence const* const seq) {
+    ASSERT(NULL != seq, ER_INVAL);
+
+    if (seq->segments) {
+        uint64_t total_us = 0;
+        ASSERT(seq->segment_count > 0, ER_INVAL);
+        for (uint16_t i = 0; i < seq->segment_count; i++) {
+#if defined(CONFIG_ZTL_COMPACT_LAYOUT)
+            ASSERT(seq->segments[i].duration_us <= ZTL_TIME_STAMP_RANGE_US, ER_INVAL);
+#endif
+            total_us += seq->segments[i].duration_us;
+        }
+        // A zero length loop would never let the scheduler catch up
+        ASSERT(total_us > 0, ER_INVAL);
+    } else {
+        ASSERT(NULL != seq->pattern, ER_INVAL);
+        ASSERT(seq->bit_count > 0, ER_INVAL);
+        ASSERT(seq->bit_period_us > 0, ER_INVAL);
+#if defined(CONFIG_ZTL_COMPACT_LAYOUT)
+        ASSERT(seq->bit_period_us <= ZTL_TIME_STAMP_RANGE_US, ER_INVAL);
+#endif
     }
 
     return 0;
 }
 
-static int handle_output(struct ZtlDigitalOutput* const self, int64_t const now) {
-    uint16_t const period = self->pulse_state ? self->pulse_on_ms : self->pulse_period_ms - self->pulse_on_ms;
+static void handle_output(struct ZtlDigitalOutput* const self, uint64_t const now, uint64_t* const deadline) {
+    if (self->sequence) {
+        handle_sequence(self, now, deadline);
+        return;
+    }
+
+    if (0 == self->pulse_count) {
+        return;
+    }
+
+#if defined(CONFIG_ZTL_DIGITAL_OUTPUT_PWM)
+    if (self->is_pwm_pulse) {
+        // The PWM peripheral makes the edges, only a finite train needs a stop
+        if (self->pulse_count > 0) {
+            if (now >= ztl_time__expand_us(now, self->tl_pulse_next_us)) {
+                self->pulse_count = 0;
+                stop_pwm_pulse(self);
+            } else {
+                *deadline = MIN(*deadline, ztl_time__expand_us(now, self->tl_pulse_next_us));
+            }
+        }
+        return;
+    }
+#endif
 
-    if (0 != self->pulse_count && IS_TIME_EXPIRED_EX(self->tl_pulse_ms, period, now)) {
-        self->tl_pulse_ms = now;
-        if (!self->pulse_state) {
+    // Transitions are scheduled against the previous deadline, not against
+    // the time they got handled, so the pulse train doesn't drift. Phases
+    // missed while the handler was late are skipped without touching the pin.
+#if defined(CONFIG_ZTL_INSTRUMENTATION)
+    uint32_t phases = 0;
+#endif
+    while (0 != self->pulse_count && now >= ztl_time__expand_us(now, self->tl_pulse_next_us)) {
+#if defined(CONFIG_ZTL_INSTRUMENTATION)
+        phases++;
+#endif
+        if (self->pulse_state) {
+            self->pulse_state = false;
+            self->tl_pulse_next_us += self->pulse_period_us - self->pulse_on_us;
+        } else {
             // Full cycle has been completed
             if (self->pulse_count > 0) {
                 self->pulse_count--;
-                if (0 == self->pulse_count) {
-                    TRY(set_output(self, self->state));
-                    return 0;
-                }
             }
+            self->pulse_state = true;
+            self->tl_pulse_next_us += self->pulse_on_us;
         }
-        self->pulse_state = !self->pulse_state;
-        TRY(set_output(self, self->pulse_state));
+    }
+#if defined(CONFIG_ZTL_INSTRUMENTATION)
+    // More than one phase in a pass, the ones in between never reached the pin
+    if (phases > 1) {
+        g_engine_stats.missed_deadlines += phases - 1;
+    }
+#endif
+
+    if (0 == self->pulse_count) {
+        set_output(self, self->state);
+    } else {
+        set_output(self, self->pulse_state);
+        *deadline = MIN(*deadline, ztl_time__expand_us(now, self->tl_pulse_next_us));
+    }
+}
+
+#if defined(CONFIG_ZTL_DIGITAL_OUTPUT_COMMAND_QUEUE)
+
+enum {
+    COMMAND_QUEUE_SIZE = CONFIG_ZTL_DIGITAL_OUTPUT_COMMAND_QUEUE_SIZE,
+};
+
+BUILD_ASSERT(IS_POWER_OF_TWO(COMMAND_QUEUE_SIZE), "Output command queue size must be a power of two");
+
+typedef enum CommandType {
+    COMMAND_TYPE__SET = 0,
+    COMMAND_TYPE__START_PULSE = 1,
+    COMMAND_TYPE__STOP_PULSE = 2,
+    // Stop the waveform, drive arg as the set state even if the pin
+    // already got written from an ISR
+    COMMAND_TYPE__FORCE = 3,
+    COMMAND_TYPE__TOGGLE = 4,
+} CommandType;
+
+// A slot is free for position P when seq == P and holds the command of
+// position P when seq == P + 1
+typedef struct Command {
+    atomic_t seq;
+    struct ZtlDigitalOutput* output;
+    int32_t arg;
+    uint8_t type;
+} Command;
+
+// Any number of producers in threads and ISRs, the output engine consumes
+// under g_outputs_mutex
+typedef struct CommandRing {
+    struct Command commands[COMMAND_QUEUE_SIZE];
+    atomic_t head;
+    atomic_val_t tail;
+} CommandRing;
+
+static struct CommandRing g_commands;
+static atomic_t g_commands_applied = ATOMIC_INIT(0);
+static atomic_t g_commands_dropped = ATOMIC_INIT(0);
+
+static int init_commands(void) {
+    for (uint16_t i = 0; i < COMMAND_QUEUE_SIZE; i++) {
+        atomic_set(&g_commands.commands[i].seq, i);
     }
 
     return 0;
 }
 
-static void output_handler(void* arg1, void* arg2, void* arg3) {
+SYS_INIT(init_commands, PRE_KERNEL_1, 0);
+
+static int post_command(struct ZtlDigitalOutput* const self, enum CommandType const type, int32_t const arg) {
+    ASSERT(NULL != self, ER_INVAL);
+
+    struct Command* command;
+    atomic_val_t pos = atomic_get(&g_commands.head);
     while (true) {
-        k_mutex_lock(&g_outputs_mutex, K_FOREVER);
-        int64_t const now = k_uptime_get();
-        for (uint8_t i = 0; i < CONFIG_ZTL_DIGITAL_OUTPUT_MAX_COUNT; i++) {
-            if (g_outputs[i]) {
-                TRY_PASS(handle_output(g_outputs[i], now));
+        command = &g_commands.commands[pos & (COMMAND_QUEUE_SIZE - 1)];
+        atomic_val_t const diff = atomic_get(&command->seq) - pos;
+        if (0 == diff) {
+            // Claimed once head moves, another producer may have taken it first
+            if (atomic_cas(&g_commands.head, pos, pos + 1)) {
+                break;
             }
+            pos = atomic_get(&g_commands.head);
+        } else if (diff < 0) {
+            // Slot of the previous lap not consumed yet
+            atomic_inc(&g_commands_dropped);
+            return ER_NO_MEM;
+        } else {
+            pos = atomic_get(&g_commands.head);
         }
-        k_mutex_unlock(&g_outputs_mutex);
-        k_msleep(THREAD_LOOP_SLEEP_MS);
     }
+
+    command->output = self;
+    command->arg = arg;
+    command->type = (uint8_t)type;
+    atomic_set(&command->seq, pos + 1);
+
+    ztl_io_engine__wakeup(ZTL_IO_ENGINE_CLIENT__OUTPUTS);
+
+    return 0;
+}
+
+// Stops the waveform and rewrites the set state to the pin
+static void force_output(struct ZtlDigitalOutput* const self, bool const state) {
+    self->state = state;
+    stop_waveform(self);
+    self->hw_state = !state;
+    set_output(self, state);
+}
+
+// Applies the queued commands in posting order. Call under g_outputs_mutex.
+static void apply_commands(uint64_t const now) {
+    while (true) {
+        struct Command* const command = &g_commands.commands[g_commands.tail & (COMMAND_QUEUE_SIZE - 1)];
+        if (atomic_get(&command->seq) != g_commands.tail + 1) {
+            // Empty, or the next producer hasn't finished writing its slot
+            break;
+        }
+
+        struct ZtlDigitalOutput* const self = command->output;
+        switch (command->type) {
+        case COMMAND_TYPE__SET:
+            self->state = 0 != command->arg;
+            if (!is_waveform_running(self)) {
+                set_output(self, self->state);
+            }
+            break;
+        case COMMAND_TYPE__START_PULSE:
+            start_pulse(self, command->arg, now);
+            break;
+        case COMMAND_TYPE__STOP_PULSE:
+            stop_waveform(self);
+            break;
+        case COMMAND_TYPE__FORCE:
+            force_output(self, 0 != command->arg);
+            break;
+        case COMMAND_TYPE__TOGGLE:
+            force_output(self, !self->state);
+            break;
+        default:
+            break;
+        }
+
+        atomic_set(&command->seq, g_commands.tail + COMMAND_QUEUE_SIZE);
+        g_commands.tail++;
+        atomic_inc(&g_commands_applied);
+    }
+}
+
+#endif
+
+uint64_t ztl_digital_output__engine_pass(void) {
+    uint64_t deadline = UINT64_MAX;
+
+    lock_outputs();
+    uint64_t const now = ztl_time__now_us();
+#if defined(CONFIG_ZTL_INSTRUMENTATION)
+    uint32_t const start_cyc = k_cycle_get_32();
+    ztl_instrument__pass_begin(&g_engine_stats, now, g_engine_scheduled_us);
+#endif
+#if defined(CONFIG_ZTL_DIGITAL_OUTPUT_COMMAND_QUEUE)
+    apply_commands(now);
+#endif
+    for (uint8_t i = 0; i < CONFIG_ZTL_DIGITAL_OUTPUT_MAX_COUNT; i++) {
+        if (g_outputs[i]) {
+            handle_output(g_outputs[i], now, &deadline);
+        }
+    }
+    // Outputs toggling in the same pass share one write per port
+    TRY_PASS(flush_outputs());
+#if defined(CONFIG_ZTL_INSTRUMENTATION)
+    g_engine_scheduled_us = deadline;
+    ztl_instrument__pass_end(&g_engine_stats, start_cyc);
+#endif
+    k_mutex_unlock(&g_outputs_mutex);
+
+    // Next pass at the earliest pulse transition, or when a pulse is started
+    return deadline;
+}
+
+// Takes slot index of g_outputs with default settings. Call under g_outputs_mutex.
+static void register_output(
+    struct ZtlDigitalOutput* const self,
+    struct gpio_dt_spec const* const gpio,
+    uint8_t const index,
+    bool const state)
+{
+    g_outputs[index] = self;
+    memset(self, 0, sizeof(*self));
+    self->gpio = gpio;
+    self->state = state;
+    self->hw_state = state;
+    self->pulse_period_us = DEFAULT_PULSE_PERIOD_MS * USEC_PER_MSEC;
+    self->pulse_on_us = DEFAULT_PULSE_ON_MS * USEC_PER_MSEC;
+    register_port(self);
+}
+
+// Not for PWM outputs, a GPIO configuration takes the pin from the PWM
+// alternate function on SoCs with pin muxing
+static int configure_gpio(struct ZtlDigitalOutput* const self) {
+    // The initial level is part of the configuration, no glitch on the pin
+    TRY(gpio_pin_configure_dt(self->gpio, self->state ? GPIO_OUTPUT_ACTIVE : GPIO_OUTPUT_INACTIVE));
+    self->hw_state = self->state;
+
+    return 0;
+}
+
+#if DT_HAS_COMPAT_STATUS_OKAY(ztl_digital_output)
+
+// Settings of a ztl,digital-output node, kept in flash
+typedef struct OutputConfig {
+    struct gpio_dt_spec gpio;
+    uint32_t pulse_period_us;
+    uint32_t pulse_on_us;
+    bool is_default_active;
+#if defined(CONFIG_ZTL_DIGITAL_OUTPUT_PWM)
+    bool has_pwm;
+    struct pwm_dt_spec pwm;
+#endif
+} OutputConfig;
+
+#if defined(CONFIG_ZTL_DIGITAL_OUTPUT_PWM)
+#define OUTPUT_DT_PWM(node_id)                                                        \
+    .has_pwm = DT_NODE_HAS_PROP(node_id, pwms),                                       \
+    .pwm = COND_CODE_1(DT_NODE_HAS_PROP(node_id, pwms), (PWM_DT_SPEC_GET(node_id)), ({0})),
+#else
+#define OUTPUT_DT_PWM(node_id)
+#endif
+
+#define OUTPUT_DT_CONFIG(node_id)                                                     \
+    {                                                                                 \
+        .gpio = GPIO_DT_SPEC_GET(node_id, gpios),                                     \
+        .pulse_period_us = DT_PROP(node_id, pulse_period_us),                         \
+        .pulse_on_us = DT_PROP(node_id, pulse_on_us),                                 \
+        .is_default_active = DT_PROP(node_id, default_active),                        \
+        OUTPUT_DT_PWM(node_id)                                                        \
+    },
+
+#define OUTPUT_DT_DEFINE(node_id) struct ZtlDigitalOutput ZTL_DIGITAL_OUTPUT_DT_NAME(node_id);
+#define OUTPUT_DT_REF(node_id) &ZTL_DIGITAL_OUTPUT_DT_NAME(node_id),
+
+DT_FOREACH_STATUS_OKAY(ztl_digital_output, OUTPUT_DT_DEFINE)
+
+static struct OutputConfig const g_dt_configs[] = {
+    DT_FOREACH_STATUS_OKAY(ztl_digital_output, OUTPUT_DT_CONFIG)
+};
+static struct ZtlDigitalOutput* const g_dt_outputs[] = {
+    DT_FOREACH_STATUS_OKAY(ztl_digital_output, OUTPUT_DT_REF)
+};
+
+BUILD_ASSERT(ARRAY_SIZE(g_dt_configs) <= CONFIG_ZTL_DIGITAL_OUTPUT_MAX_COUNT, "Too many ztl,digital-output nodes");
+
+// DT outputs take the first slots in node order without a duplicate scan
+static int init_dt_outputs(void) {
+    int rc = 0;
+
+    lock_outputs();
+
+    for (uint8_t i = 0; i < ARRAY_SIZE(g_dt_configs); i++) {
+        struct OutputConfig const* const config = &g_dt_configs[i];
+        struct ZtlDigitalOutput* const self = g_dt_outputs[i];
+
+        register_output(self, &config->gpio, i, config->is_default_active);
+        self->pulse_period_us = config->pulse_period_us;
+        self->pulse_on_us = config->pulse_on_us;
+#if defined(CONFIG_ZTL_DIGITAL_OUTPUT_PWM)
+        if (config->has_pwm && pwm_is_ready_dt(&config->pwm)) {
+            self->pwm = &config->pwm;
+            set_pwm_level(self, self->state);
+            continue;
+        }
+#endif
+        TRY_EX(configure_gpio(self));
+    }
+
+ finally:
+
+    k_mutex_unlock(&g_outputs_mutex);
+
+    if (rc < 0) {
+        LOG_ERR("DT output init failed: %d", rc);
+    }
+
+    return rc;
 }
 
+SYS_INIT(init_dt_outputs, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
+
+#endif
 
 int ztl_digital_output__init(struct ZtlDigitalOutput* const self, struct gpio_dt_spec const* const gpio) {
     int rc = ER_NO_MEM;
@@ -77,7 +626,7 @@ int ztl_digital_output__init(struct ZtlDigitalOutput* const self, struct gpio_dt
     ASSERT(NULL != self, ER_INVAL);
     ASSERT(NULL != gpio, ER_INVAL);
 
-    k_mutex_lock(&g_outputs_mutex, K_FOREVER);
+    lock_outputs();
 
     for (uint8_t i = 0; i < CONFIG_ZTL_DIGITAL_OUTPUT_MAX_COUNT; i++) {
         if (g_outputs[i]) {
@@ -85,15 +634,10 @@ int ztl_digital_output__init(struct ZtlDigitalOutput* const self, struct gpio_dt
         }
     }
 
-    for (int i = 0; i < CONFIG_ZTL_DIGITAL_OUTPUT_MAX_COUNT; i++) {
+    for (uint8_t i = 0; i < CONFIG_ZTL_DIGITAL_OUTPUT_MAX_COUNT; i++) {
         if (NULL == g_outputs[i]) {
-            g_outputs[i] = self;
-            memset(self, 0, sizeof(*self));
-            self->gpio = gpio;
-            self->pulse_period_ms = DEFAULT_PULSE_PERIOD_MS;
-            self->pulse_on_ms = DEFAULT_BLINK_ON_MS;
-            TRY_EX(gpio_pin_configure_dt(self->gpio, GPIO_OUTPUT));
-            TRY_EX(gpio_pin_set_dt(gpio, self->state));
+            register_output(self, gpio, i, false);
+            TRY_EX(configure_gpio(self));
             rc = 0;
             break;
         }
@@ -108,15 +652,15 @@ int ztl_digital_output__init(struct ZtlDigitalOutput* const self, struct gpio_dt
 
 int ztl_digital_output__set(struct ZtlDigitalOutput* const self, bool const state) {
     int rc = 0;
-    k_mutex_lock(&g_outputs_mutex, K_FOREVER);
+    lock_outputs();
 
     ASSERT_EX(NULL != self, ER_INVAL);
 
-    if (0 == self->pulse_count) {
-        TRY(set_output(self, state));
-    }
-
     self->state = state;
+    if (!is_waveform_running(self)) {
+        set_output(self, state);
+        TRY_EX(flush_outputs());
+    }
 
  finally:
 
@@ -125,35 +669,42 @@ int ztl_digital_output__set(struct ZtlDigitalOutput* const self, bool const stat
     return rc;
 }
 
-int ztl_digital_output__start_blink(struct ZtlDigitalOutput* const self, int const pulse_count) {
+int ztl_digital_output__start_pulse(struct ZtlDigitalOutput* const self, int32_t const pulse_count) {
     int rc = 0;
-    k_mutex_lock(&g_outputs_mutex, K_FOREVER);
+    lock_outputs();
 
     ASSERT_EX(NULL != self, ER_INVAL);
 
-    self->pulse_count = pulse_count;
-    self->pulse_state = true;
-    self->tl_pulse_ms = k_uptime_get();
-    TRY_EX(set_output(self, self->pulse_state));
+    start_pulse(self, pulse_count, ztl_time__now_us());
+    TRY_EX(flush_outputs());
 
  finally:
 
     k_mutex_unlock(&g_outputs_mutex);
+    ztl_io_engine__wakeup(ZTL_IO_ENGINE_CLIENT__OUTPUTS);
 
     return rc;
 }
 
-int ztl_digital_output__config_blink(struct ZtlDigitalOutput* const self, uint16_t const pulse_period_ms, uint16_t const pulse_on_ms) {
+int ztl_digital_output__config_pulse(struct ZtlDigitalOutput* const self, uint16_t const pulse_period_ms, uint16_t const pulse_on_ms) {
+    return ztl_digital_output__config_pulse_us(
+        self, (uint32_t)pulse_period_ms * USEC_PER_MSEC, (uint32_t)pulse_on_ms * USEC_PER_MSEC);
+}
+
+int ztl_digital_output__config_pulse_us(struct ZtlDigitalOutput* const self, uint32_t const pulse_period_us, uint32_t const pulse_on_us) {
     int rc = 0;
 
-    k_mutex_lock(&g_outputs_mutex, K_FOREVER);
+    lock_outputs();
 
     ASSERT_EX(NULL != self, ER_INVAL);
-    ASSERT_EX(pulse_on_ms > 0, ER_INVAL);
-    ASSERT_EX(pulse_on_ms < pulse_period_ms, ER_INVAL);
+    ASSERT_EX(pulse_on_us > 0, ER_INVAL);
+    ASSERT_EX(pulse_on_us < pulse_period_us, ER_INVAL);
+#if defined(CONFIG_ZTL_COMPACT_LAYOUT)
+    ASSERT_EX(pulse_period_us <= ZTL_TIME_STAMP_RANGE_US, ER_INVAL);
+#endif
 
-    self->pulse_period_ms = pulse_period_ms;
-    self->pulse_on_ms = pulse_on_ms;
+    self->pulse_period_us = pulse_period_us;
+    self->pulse_on_us = pulse_on_us;
 
  finally:
 
@@ -162,14 +713,62 @@ int ztl_digital_output__config_blink(struct ZtlDigitalOutput* const self, uint16
     return rc;
 }
 
-int ztl_digital_output__stop_blink(struct ZtlDigitalOutput* const self) {
+int ztl_digital_output__stop_pulse(struct ZtlDigitalOutput* const self) {
     int rc = 0;
-    k_mutex_lock(&g_outputs_mutex, K_FOREVER);
+    lock_outputs();
 
     ASSERT_EX(NULL != self, ER_INVAL);
 
-    self->pulse_count = 0;
-    TRY_EX(set_output(self, self->state));
+    stop_waveform(self);
+    TRY_EX(flush_outputs());
+
+ finally:
+
+    k_mutex_unlock(&g_outputs_mutex);
+
+    return rc;
+}
+
+int ztl_digital_output__start_sequence(
+    struct ZtlDigitalOutput* const self,
+    struct ZtlDigitalOutputSequence const* const seq,
+    int32_t const loop_count)
+{
+    int rc = 0;
+    ASSERT(NULL != self, ER_INVAL);
+    ASSERT(0 != loop_count, ER_INVAL);
+    TRY(check_sequence(seq));
+
+    lock_outputs();
+    start_sequence(self, seq, loop_count, ztl_time__now_us());
+    TRY_EX(flush_outputs());
+
+ finally:
+
+    k_mutex_unlock(&g_outputs_mutex);
+    ztl_io_engine__wakeup(ZTL_IO_ENGINE_CLIENT__OUTPUTS);
+
+    return rc;
+}
+
+#if defined(CONFIG_ZTL_DIGITAL_OUTPUT_PWM)
+int ztl_digital_output__set_pwm(struct ZtlDigitalOutput* const self, struct pwm_dt_spec const* const pwm) {
+    int rc = 0;
+    ASSERT(NULL != self, ER_INVAL);
+
+    lock_outputs();
+
+    ASSERT_EX(!is_waveform_running(self), ER_ALREADY);
+    ASSERT_EX(NULL == pwm || pwm_is_ready_dt(pwm), ER_INVAL);
+
+    self->pwm = pwm;
+    if (pwm) {
+        // The pin is driven by the PWM peripheral from now on
+        set_pwm_level(self, self->state);
+    } else {
+        // Back from the PWM alternate function at the current level
+        TRY_EX(configure_gpio(self));
+    }
 
  finally:
 
@@ -177,3 +776,259 @@ int ztl_digital_output__stop_blink(struct ZtlDigitalOutput* const self) {
 
     return rc;
 }
+#endif
+
+#if defined(CONFIG_ZTL_DIGITAL_OUTPUT_COMMAND_QUEUE)
+int ztl_digital_output__post_set(struct ZtlDigitalOutput* const self, bool const state) {
+    return post_command(self, COMMAND_TYPE__SET, state ? 1 : 0);
+}
+
+int ztl_digital_output__post_start_pulse(struct ZtlDigitalOutput* const self, int32_t const pulse_count) {
+    return post_command(self, COMMAND_TYPE__START_PULSE, pulse_count);
+}
+
+int ztl_digital_output__post_stop_pulse(struct ZtlDigitalOutput* const self) {
+    return post_command(self, COMMAND_TYPE__STOP_PULSE, 0);
+}
+
+#if defined(CONFIG_ZTL_REFLEX)
+void ztl_digital_output__reflex(
+    struct ZtlDigitalOutput* const self,
+    enum ZtlReflexAction const action,
+    int32_t const pulse_count,
+    bool is_direct)
+{
+#if defined(CONFIG_ZTL_DIGITAL_OUTPUT_PWM)
+    is_direct = is_direct && NULL == self->pwm;
+#endif
+#if defined(CONFIG_ZTL_SHIFT_REGISTER)
+    // Chain ports transfer under a mutex, the edge ISR leaves them to the command
+    is_direct = is_direct && !ztl_shift_register__is_port(self->gpio->port);
+#endif
+
+    // Unlocked reads, the queued command settles the state whatever they see
+    switch (action) {
+    case ZTL_REFLEX_ACTION__SET:
+    case ZTL_REFLEX_ACTION__CLEAR: {
+        bool const state = ZTL_REFLEX_ACTION__SET == action;
+        if (is_direct) {
+            gpio_pin_set_dt(self->gpio, state ? 1 : 0);
+        }
+        post_command(self, COMMAND_TYPE__FORCE, state ? 1 : 0);
+        break;
+    }
+    case ZTL_REFLEX_ACTION__TOGGLE:
+        // The pin shows the set state only without a waveform
+        if (is_direct && !is_waveform_running(self)) {
+            gpio_pin_toggle_dt(self->gpio);
+        }
+        post_command(self, COMMAND_TYPE__TOGGLE, 0);
+        break;
+    case ZTL_REFLEX_ACTION__START_PULSE:
+        post_command(self, COMMAND_TYPE__START_PULSE, pulse_count);
+        break;
+    default:
+        break;
+    }
+}
+#endif
+
+int ztl_digital_output__command_stats(struct ZtlDigitalOutputCommandStats* const stats) {
+    ASSERT(NULL != stats, ER_INVAL);
+
+    stats->applied = (uint32_t)atomic_get(&g_commands_applied);
+    stats->dropped = (uint32_t)atomic_get(&g_commands_dropped);
+
+    return 0;
+}
+#endif
+
+#if defined(CONFIG_ZTL_INSTRUMENTATION)
+int ztl_digital_output__engine_stats(struct ZtlInstrumentEngineStats* const stats) {
+    ASSERT(NULL != stats, ER_INVAL);
+
+    lock_outputs();
+    *stats = g_engine_stats;
+    k_mutex_unlock(&g_outputs_mutex);
+
+    return 0;
+}
+
+int ztl_digital_output__reset_stats(void) {
+    lock_outputs();
+    memset(&g_engine_stats, 0, sizeof(g_engine_stats));
+    k_mutex_unlock(&g_outputs_mutex);
+
+    return 0;
+}
+#endif
+
+int ztl_digital_output_group__init(
+    struct ZtlDigitalOutputGroup* const self,
+    struct ZtlDigitalOutput* const* const outputs,
+    uint8_t const count)
+{
+    ASSERT(NULL != self, ER_INVAL);
+    ASSERT(NULL != outputs, ER_INVAL);
+    ASSERT(count > 0 && count <= ZTL_DIGITAL_OUTPUT_GROUP_MAX_COUNT, ER_INVAL);
+
+    for (uint8_t i = 0; i < count; i++) {
+        ASSERT(NULL != outputs[i], ER_INVAL);
+    }
+
+    self->outputs = outputs;
+    self->count = count;
+
+    return 0;
+}
+
+int ztl_digital_output_group__set(struct ZtlDigitalOutputGroup const* const self, uint32_t const mask, uint32_t const states) {
+    int rc = 0;
+    ASSERT(NULL != self, ER_INVAL);
+
+    lock_outputs();
+
+    for (uint8_t i = 0; i < self->count; i++) {
+        if (mask & BIT(i)) {
+            struct ZtlDigitalOutput* const output = self->outputs[i];
+            output->state = 0 != (states & BIT(i));
+            if (!is_waveform_running(output)) {
+                set_output(output, output->state);
+            }
+        }
+    }
+    TRY_EX(flush_outputs());
+
+ finally:
+
+    k_mutex_unlock(&g_outputs_mutex);
+
+    return rc;
+}
+
+int ztl_digital_output_group__config_pulse(
+    struct ZtlDigitalOutputGroup const* const self,
+    uint32_t const mask,
+    uint16_t const pulse_period_ms,
+    uint16_t const pulse_on_ms)
+{
+    return ztl_digital_output_group__config_pulse_us(
+        self, mask, (uint32_t)pulse_period_ms * USEC_PER_MSEC, (uint32_t)pulse_on_ms * USEC_PER_MSEC);
+}
+
+int ztl_digital_output_group__config_pulse_us(
+    struct ZtlDigitalOutputGroup const* const self,
+    uint32_t const mask,
+    uint32_t const pulse_period_us,
+    uint32_t const pulse_on_us)
+{
+    ASSERT(NULL != self, ER_INVAL);
+    ASSERT(pulse_on_us > 0, ER_INVAL);
+    ASSERT(pulse_on_us < pulse_period_us, ER_INVAL);
+#if defined(CONFIG_ZTL_COMPACT_LAYOUT)
+    ASSERT(pulse_period_us <= ZTL_TIME_STAMP_RANGE_US, ER_INVAL);
+#endif
+
+    lock_outputs();
+
+    for (uint8_t i = 0; i < self->count; i++) {
+        if (mask & BIT(i)) {
+            self->outputs[i]->pulse_period_us = pulse_period_us;
+            self->outputs[i]->pulse_on_us = pulse_on_us;
+        }
+    }
+
+    k_mutex_unlock(&g_outputs_mutex);
+
+    return 0;
+}
+
+int ztl_digital_output_group__start_pulse(struct ZtlDigitalOutputGroup const* const self, uint32_t const mask, int32_t const pulse_count) {
+    int rc = 0;
+    ASSERT(NULL != self, ER_INVAL);
+
+    lock_outputs();
+
+    // One time base for all outputs keeps equally configured trains toggling in the same write
+    uint64_t const now = ztl_time__now_us();
+    for (uint8_t i = 0; i < self->count; i++) {
+        if (mask & BIT(i)) {
+            start_pulse(self->outputs[i], pulse_count, now);
+        }
+    }
+    TRY_EX(flush_outputs());
+
+ finally:
+
+    k_mutex_unlock(&g_outputs_mutex);
+    ztl_io_engine__wakeup(ZTL_IO_ENGINE_CLIENT__OUTPUTS);
+
+    return rc;
+}
+
+int ztl_digital_output_group__stop_pulse(struct ZtlDigitalOutputGroup const* const self, uint32_t const mask) {
+    int rc = 0;
+    ASSERT(NULL != self, ER_INVAL);
+
+    lock_outputs();
+
+    for (uint8_t i = 0; i < self->count; i++) {
+        if (mask & BIT(i)) {
+            stop_waveform(self->outputs[i]);
+        }
+    }
+    TRY_EX(flush_outputs());
+
+ finally:
+
+    k_mutex_unlock(&g_outputs_mutex);
+
+    return rc;
+}
+
+int ztl_digital_output_group__start_sequence(
+    struct ZtlDigitalOutputGroup const* const self,
+    uint32_t const mask,
+    struct ZtlDigitalOutputSequence const* const* const seqs,
+    int32_t const loop_count)
+{
+    int rc = 0;
+    ASSERT(NULL != self, ER_INVAL);
+    ASSERT(NULL != seqs, ER_INVAL);
+    ASSERT(0 != loop_count, ER_INVAL);
+
+    for (uint8_t i = 0; i < self->count; i++) {
+        if (mask & BIT(i)) {
+            TRY(check_sequence(seqs[i]));
+        }
+    }
+
+    lock_outputs();
+
+    // One timeline for all sequences keeps them phase-locked
+    uint64_t const now = ztl_time__now_us();
+    for (uint8_t i = 0; i < self->count; i++) {
+        if (mask & BIT(i)) {
+            start_sequence(self->outputs[i], seqs[i], loop_count, now);
+        }
+    }
+    TRY_EX(flush_outputs());
+
+ finally:
+
+    k_mutex_unlock(&g_outputs_mutex);
+    ztl_io_engine__wakeup(ZTL_IO_ENGINE_CLIENT__OUTPUTS);
+
+    return rc;
+}
+
+#if defined(CONFIG_ZTL_FOOTPRINT_REPORT)
+// Sizes as absolute ELF symbols without storage, printed after the link
+GEN_ABS_SYM_BEGIN(ztl_digital_output_footprint)
+GEN_ABSOLUTE_SYM(ztl_sizeof_digital_output, sizeof(struct ZtlDigitalOutput));
+GEN_ABSOLUTE_SYM(ztl_sizeof_digital_output_tables, sizeof(g_outputs) + sizeof(g_ports));
+#if defined(CONFIG_ZTL_DIGITAL_OUTPUT_COMMAND_QUEUE)
+GEN_ABSOLUTE_SYM(ztl_sizeof_digital_output_commands, sizeof(g_commands));
+#endif
+GEN_ABS_SYM_END
+#endif
@@ -2,28 +2,146 @@
 #define ZTL_DIGITAL_OUTPUT_H_
 
 #include "digital_common.h"
+#include "time.h"
+
+#if defined(CONFIG_ZTL_INSTRUMENTATION)
+#include "instrument.h"
+#endif
 
 #include <zephyr/drivers/gpio.h>
 #include <zephyr/devicetree.h>
 #include <zephyr/sys/mutex.h>
 
+#if defined(CONFIG_ZTL_DIGITAL_OUTPUT_PWM)
+#include <zephyr/drivers/pwm.h>
+#endif
+
+enum {
+    ZTL_DIGITAL_OUTPUT_GROUP_MAX_COUNT = 32,
+};
+
+typedef struct ZtlDigitalOutputSegment {
+    bool level;
+    uint32_t duration_us;
+} ZtlDigitalOutputSegment;
+
+// Waveform played by the output scheduler, usually a const in flash. Either
+// level/duration segments, or a bit pattern where bit N of pattern[N / 32]
+// is the level for one bit_period_us.
+typedef struct ZtlDigitalOutputSequence {
+    struct ZtlDigitalOutputSegment const* segments;
+    uint16_t segment_count;
+    uint32_t const* pattern;
+    uint16_t bit_count;
+    uint32_t bit_period_us;
+} ZtlDigitalOutputSequence;
+
 typedef struct ZtlDigitalOutput {
     struct gpio_dt_spec const* gpio;
-    bool state;
-    bool hw_state;
+    // Index of the output port in the port write table
+    uint8_t port_idx;
+    bool state ZTL_BITS(1);
+    bool hw_state ZTL_BITS(1);
+    bool pulse_state ZTL_BITS(1);
+#if defined(CONFIG_ZTL_DIGITAL_OUTPUT_PWM)
+    bool is_pwm_pulse ZTL_BITS(1);
+#endif
+    uint16_t sequence_idx;
     int32_t pulse_count;
-    uint16_t pulse_period_ms;
-    uint16_t pulse_on_ms;
-    uint64_t tl_pulse_ms;
-    bool pulse_state;
+    // Next pulse transition, microseconds of ztl_time__now_us()
+    ztl_stamp_t tl_pulse_next_us;
+    uint32_t pulse_period_us;
+    uint32_t pulse_on_us;
+    // Running sequence, NULL when none
+    struct ZtlDigitalOutputSequence const* sequence;
+    int32_t sequence_loops;
+
+#if defined(CONFIG_ZTL_DIGITAL_OUTPUT_PWM)
+    // Pulse trains are handed to this PWM channel when set, a finite train
+    // is stopped at tl_pulse_next_us
+    struct pwm_dt_spec const* pwm;
+#endif
 } ZtlDigitalOutput;
 
+typedef struct ZtlDigitalOutputCommandStats {
+    // Commands applied by the output engine
+    uint32_t applied;
+    // Commands lost because the queue was full
+    uint32_t dropped;
+} ZtlDigitalOutputCommandStats;
+
+// Outputs switched together, bit N of a group mask selects outputs[N]
+typedef struct ZtlDigitalOutputGroup {
+    struct ZtlDigitalOutput* const* outputs;
+    uint8_t count;
+} ZtlDigitalOutputGroup;
+
+// Outputs of enabled ztl,digital-output nodes are allocated and registered
+// before main(), ZTL_DIGITAL_OUTPUT_DT_GET() returns one of them
+#define ZTL_DIGITAL_OUTPUT_DT_NAME(node_id) UTIL_CAT(ztl_digital_output_, DT_DEP_ORD(node_id))
+#define ZTL_DIGITAL_OUTPUT_DT_GET(node_id) (&ZTL_DIGITAL_OUTPUT_DT_NAME(node_id))
+#define ZTL_DIGITAL_OUTPUT_DT_DECLARE(node_id) extern struct ZtlDigitalOutput ZTL_DIGITAL_OUTPUT_DT_NAME(node_id);
+
+DT_FOREACH_STATUS_OKAY(ztl_digital_output, ZTL_DIGITAL_OUTPUT_DT_DECLARE)
+
 int ztl_digital_output__init(struct ZtlDigitalOutput* self, struct gpio_dt_spec const* gpio);
 int ztl_digital_output__set(struct ZtlDigitalOutput* self, bool state);
 int ztl_digital_output__start_pulse(struct ZtlDigitalOutput* self, int32_t pulse_count);
 int ztl_digital_output__config_pulse(struct ZtlDigitalOutput* self, uint16_t pulse_period_ms, uint16_t pulse_on_ms);
+int ztl_digital_output__config_pulse_us(struct ZtlDigitalOutput* self, uint32_t pulse_period_us, uint32_t pulse_on_us);
 int ztl_digital_output__stop_pulse(struct ZtlDigitalOutput* self);
-int ztl_digital_output__is_pulse_run(struct ZtlDigitalOutput* self, bool* is_running);
-int ztl_digital_output__wait_pulse_end(struct ZtlDigitalOutput* self);
+// Plays the sequence loop_count times, forever when negative. Stopped by
+// ztl_digital_output__stop_pulse().
+int ztl_digital_output__start_sequence(
+    struct ZtlDigitalOutput* self,
+    struct ZtlDigitalOutputSequence const* seq,
+    int32_t loop_count);
+
+#if defined(CONFIG_ZTL_DIGITAL_OUTPUT_PWM)
+// Drives the output through the PWM channel of its pwms DT property,
+// e.g. PWM_DT_SPEC_GET(node). NULL configures the pin as a GPIO output
+// again. The pin mux is not touched when the PWM takes over, outputs with
+// a pwms DT property never leave it.
+int ztl_digital_output__set_pwm(struct ZtlDigitalOutput* self, struct pwm_dt_spec const* pwm);
+#endif
+
+#if defined(CONFIG_ZTL_DIGITAL_OUTPUT_COMMAND_QUEUE)
+// Non-blocking variants, ISR safe. Queued commands are applied in posting
+// order by the next output engine pass, ER_NO_MEM when the queue is full.
+// Their order against the blocking calls on the same output is undefined.
+int ztl_digital_output__post_set(struct ZtlDigitalOutput* self, bool state);
+int ztl_digital_output__post_start_pulse(struct ZtlDigitalOutput* self, int32_t pulse_count);
+int ztl_digital_output__post_stop_pulse(struct ZtlDigitalOutput* self);
+int ztl_digital_output__command_stats(struct ZtlDigitalOutputCommandStats* stats);
+#endif
+
+#if defined(CONFIG_ZTL_INSTRUMENTATION)
+int ztl_digital_output__engine_stats(struct ZtlInstrumentEngineStats* stats);
+int ztl_digital_output__reset_stats(void);
+#endif
+
+int ztl_digital_output_group__init(
+    struct ZtlDigitalOutputGroup* self,
+    struct ZtlDigitalOutput* const* outputs,
+    uint8_t count);
+int ztl_digital_output_group__set(struct ZtlDigitalOutputGroup const* self, uint32_t mask, uint32_t states);
+int ztl_digital_output_group__config_pulse(
+    struct ZtlDigitalOutputGroup const* self,
+    uint32_t mask,
+    uint16_t pulse_period_ms,
+    uint16_t pulse_on_ms);
+int ztl_digital_output_group__config_pulse_us(
+    struct ZtlDigitalOutputGroup const* self,
+    uint32_t mask,
+    uint32_t pulse_period_us,
+    uint32_t pulse_on_us);
+int ztl_digital_output_group__start_pulse(struct ZtlDigitalOutputGroup const* self, uint32_t mask, int32_t pulse_count);
+int ztl_digital_output_group__stop_pulse(struct ZtlDigitalOutputGroup const* self, uint32_t mask);
+// Starts seqs[N] on every selected outputs[N] from the same timestamp
+int ztl_digital_output_group__start_sequence(
+    struct ZtlDigitalOutputGroup const* self,
+    uint32_t mask,
+    struct ZtlDigitalOutputSequence const* const* seqs,
+    int32_t loop_count);
 
 #endif // ZTL_DIGITAL_OUTPUT_H_
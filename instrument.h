@@ -0,0 +1,73 @@
+#ifndef ZTL_INSTRUMENT_H_
+#define ZTL_INSTRUMENT_H_
+
+#include "time.h"
+
+#include <zephyr/kernel.h>
+#include <zephyr/sys/math_extras.h>
+#include <zephyr/types.h>
+
+enum {
+    // Bucket N counts passes shorter than 16 << N us, the last one the rest
+    ZTL_INSTRUMENT_BUCKET_COUNT = 8,
+    ZTL_INSTRUMENT_BUCKET_MIN_US = 16,
+};
+
+// Figures of the input or the output engine, updated with the engine
+// mutex held
+typedef struct ZtlInstrumentEngineStats {
+    uint32_t passes;
+    uint32_t duration_histogram[ZTL_INSTRUMENT_BUCKET_COUNT];
+    uint32_t duration_last_us;
+    uint32_t duration_max_us;
+    // Pass start behind the deadline it was scheduled for
+    uint32_t jitter_last_us;
+    uint32_t jitter_max_us;
+    // Input samples or pulse phases skipped because a pass came too late
+    uint32_t missed_deadlines;
+    // Time spent waiting for the engine mutex, any caller
+    uint32_t mutex_locks;
+    uint32_t mutex_wait_max_us;
+    uint64_t mutex_wait_total_us;
+} ZtlInstrumentEngineStats;
+
+static inline uint8_t ztl_instrument__bucket(uint32_t const duration_us) {
+    uint32_t const units = duration_us / ZTL_INSTRUMENT_BUCKET_MIN_US;
+    if (0 == units) {
+        return 0;
+    }
+    // Index of the highest set bit, plus one
+    uint8_t const bucket = (uint8_t)(32 - u32_count_leading_zeros(units));
+    return MIN(bucket, ZTL_INSTRUMENT_BUCKET_COUNT - 1);
+}
+
+static inline void ztl_instrument__lock(struct k_mutex* const mutex, struct ZtlInstrumentEngineStats* const stats) {
+    uint32_t const start_cyc = k_cycle_get_32();
+    k_mutex_lock(mutex, K_FOREVER);
+    uint32_t const wait_us = k_cyc_to_us_floor32(k_cycle_get_32() - start_cyc);
+
+    stats->mutex_locks++;
+    stats->mutex_wait_max_us = MAX(stats->mutex_wait_max_us, wait_us);
+    stats->mutex_wait_total_us += wait_us;
+}
+
+// Call at the start of a pass, scheduled_us is the deadline returned by the previous one
+static inline void ztl_instrument__pass_begin(struct ZtlInstrumentEngineStats* const stats, uint64_t const now, uint64_t const scheduled_us) {
+    // Passes woken before their deadline have no jitter to record
+    if (UINT64_MAX != scheduled_us && now >= scheduled_us) {
+        uint32_t const jitter_us = (uint32_t)MIN(now - scheduled_us, UINT32_MAX);
+        stats->jitter_last_us = jitter_us;
+        stats->jitter_max_us = MAX(stats->jitter_max_us, jitter_us);
+    }
+}
+
+static inline void ztl_instrument__pass_end(struct ZtlInstrumentEngineStats* const stats, uint32_t const start_cyc) {
+    uint32_t const duration_us = k_cyc_to_us_floor32(k_cycle_get_32() - start_cyc);
+
+    stats->passes++;
+    stats->duration_histogram[ztl_instrument__bucket(duration_us)]++;
+    stats->duration_last_us = duration_us;
+    stats->duration_max_us = MAX(stats->duration_max_us, duration_us);
+}
+
+#endif // ZTL_INSTRUMENT_H_
@@ -0,0 +1,154 @@
+#include "digital_input.h"
+#include "digital_output.h"
+#include "instrument.h"
+
+#include <zephyr/shell/shell.h>
+
+static void print_engine(struct shell const* const sh, char const* const name, struct ZtlInstrumentEngineStats const* const stats) {
+    shell_print(sh, "%s: %u passes, duration last %u us max %u us, jitter last %u us max %u us, missed %u",
+                name, stats->passes, stats->duration_last_us, stats->duration_max_us,
+                stats->jitter_last_us, stats->jitter_max_us, stats->missed_deadlines);
+    shell_print(sh, "  mutex: %u locks, wait max %u us total %llu us",
+                stats->mutex_locks, stats->mutex_wait_max_us, (unsigned long long)stats->mutex_wait_total_us);
+    for (uint8_t i = 0; i < ZTL_INSTRUMENT_BUCKET_COUNT; i++) {
+        if (i < ZTL_INSTRUMENT_BUCKET_COUNT - 1) {
+            shell_print(sh, "  < %5u us: %u", ZTL_INSTRUMENT_BUCKET_MIN_US << i, stats->duration_histogram[i]);
+        } else {
+            shell_print(sh, "  >=%5u us: %u", ZTL_INSTRUMENT_BUCKET_MIN_US << (i - 1), stats->duration_histogram[i]);
+        }
+    }
+}
+
+static int cmd_engines(struct shell const* const sh, size_t const argc, char** const argv) {
+    struct ZtlInstrumentEngineStats stats;
+
+    int rc = ztl_digital_input__engine_stats(&stats);
+    if (rc < 0) {
+        return rc;
+    }
+    print_engine(sh, "inputs", &stats);
+
+    rc = ztl_digital_output__engine_stats(&stats);
+    if (rc < 0) {
+        return rc;
+    }
+    print_engine(sh, "outputs", &stats);
+
+    return 0;
+}
+
+static int cmd_inputs(struct shell const* const sh, size_t const argc, char** const argv) {
+    struct ZtlDigitalInputStats stats;
+
+    for (uint8_t i = 0; i < CONFIG_ZTL_DIGITAL_INPUT_MAX_COUNT; i++) {
+        struct ZtlDigitalInput* input = NULL;
+        int rc = ztl_digital_input__get(i, &input);
+        if (rc < 0) {
+            return rc;
+        }
+        if (NULL == input) {
+            continue;
+        }
+        rc = ztl_digital_input__stats(input, &stats);
+        if (rc < 0) {
+            return rc;
+        }
+
+        shell_print(sh, "%u %s.%u: %u edges, %u edges/s, debounce error last %u us max %u us",
+                    i, stats.gpio->port->name, stats.gpio->pin, stats.edges, stats.edges_per_sec,
+                    stats.debounce_error_last_us, stats.debounce_error_max_us);
+        for (uint8_t j = 0; j < CONFIG_ZTL_DIGITAL_INPUT_MAX_SUBSCRIBERS_COUNT; j++) {
+            struct ZtlDigitalInputSubscriberStats const* const sub = &stats.subscribers[j];
+            if (sub->callback) {
+                shell_print(sh, "  %p: %u calls, latency last %u us max %u us, run last %u us max %u us",
+                            (void*)sub->callback, sub->calls, sub->latency_last_us, sub->latency_max_us,
+                            sub->last_us, sub->max_us);
+            }
+        }
+    }
+
+    return 0;
+}
+
+// One JSON object per line, for scripts collecting results from a console
+static void print_engine_json(struct shell const* const sh, char const* const name, struct ZtlInstrumentEngineStats const* const stats) {
+    uint32_t const* const h = stats->duration_histogram;
+    BUILD_ASSERT(ZTL_INSTRUMENT_BUCKET_COUNT == 8, "Histogram format below lists 8 buckets");
+
+    shell_print(sh,
+                "{\"engine\":\"%s\",\"passes\":%u,\"duration_us\":{\"last\":%u,\"max\":%u},"
+                "\"histogram\":[%u,%u,%u,%u,%u,%u,%u,%u],\"jitter_us\":{\"last\":%u,\"max\":%u},"
+                "\"missed\":%u,\"mutex\":{\"locks\":%u,\"wait_max_us\":%u,\"wait_total_us\":%llu}}",
+                name, stats->passes, stats->duration_last_us, stats->duration_max_us,
+                h[0], h[1], h[2], h[3], h[4], h[5], h[6], h[7],
+                stats->jitter_last_us, stats->jitter_max_us, stats->missed_deadlines,
+                stats->mutex_locks, stats->mutex_wait_max_us, (unsigned long long)stats->mutex_wait_total_us);
+}
+
+static int cmd_json(struct shell const* const sh, size_t const argc, char** const argv) {
+    struct ZtlInstrumentEngineStats engine;
+    struct ZtlDigitalInputStats stats;
+
+    int rc = ztl_digital_input__engine_stats(&engine);
+    if (rc < 0) {
+        return rc;
+    }
+    print_engine_json(sh, "inputs", &engine);
+
+    rc = ztl_digital_output__engine_stats(&engine);
+    if (rc < 0) {
+        return rc;
+    }
+    print_engine_json(sh, "outputs", &engine);
+
+    for (uint8_t i = 0; i < CONFIG_ZTL_DIGITAL_INPUT_MAX_COUNT; i++) {
+        struct ZtlDigitalInput* input = NULL;
+        rc = ztl_digital_input__get(i, &input);
+        if (rc < 0) {
+            return rc;
+        }
+        if (NULL == input) {
+            continue;
+        }
+        rc = ztl_digital_input__stats(input, &stats);
+        if (rc < 0) {
+            return rc;
+        }
+
+        shell_print(sh,
+                    "{\"input\":%u,\"port\":\"%s\",\"pin\":%u,\"edges\":%u,\"edges_per_sec\":%u,"
+                    "\"debounce_error_us\":{\"last\":%u,\"max\":%u}}",
+                    i, stats.gpio->port->name, stats.gpio->pin, stats.edges, stats.edges_per_sec,
+                    stats.debounce_error_last_us, stats.debounce_error_max_us);
+        for (uint8_t j = 0; j < CONFIG_ZTL_DIGITAL_INPUT_MAX_SUBSCRIBERS_COUNT; j++) {
+            struct ZtlDigitalInputSubscriberStats const* const sub = &stats.subscribers[j];
+            if (sub->callback) {
+                shell_print(sh,
+                            "{\"input\":%u,\"subscriber\":%u,\"calls\":%u,"
+                            "\"latency_us\":{\"last\":%u,\"max\":%u},\"callback_us\":{\"last\":%u,\"max\":%u}}",
+                            i, j, sub->calls, sub->latency_last_us, sub->latency_max_us, sub->last_us, sub->max_us);
+            }
+        }
+    }
+
+    return 0;
+}
+
+static int cmd_reset(struct shell const* const sh, size_t const argc, char** const argv) {
+    int rc = ztl_digital_input__reset_stats();
+    if (rc < 0) {
+        return rc;
+    }
+
+    return ztl_digital_output__reset_stats();
+}
+
+SHELL_STATIC_SUBCMD_SET_CREATE(
+    sub_ztl,
+    SHELL_CMD(engines, NULL, "Scan durations, jitter, missed deadlines and mutex waits", cmd_engines),
+    SHELL_CMD(inputs, NULL, "Edge rates and subscriber callback times per input", cmd_inputs),
+    SHELL_CMD(json, NULL, "All statistics as JSON lines", cmd_json),
+    SHELL_CMD(reset, NULL, "Clear the statistics", cmd_reset),
+    SHELL_SUBCMD_SET_END);
+
+SHELL_CMD_REGISTER(ztl, &sub_ztl, "ztl I/O engine statistics", NULL);
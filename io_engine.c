@@ -0,0 +1,129 @@
+#include "io_engine.h"
+#include "time.h"
+
+#include <zephyr/init.h>
+#include <zephyr/kernel.h>
+#include <zephyr/toolchain.h>
+
+// Handles what is due on the engines served by one context and returns
+// the earliest next deadline. Inputs go first so outputs driven from
+// input callbacks are applied in the same pass.
+static uint64_t run_pass(bool const inputs, bool const outputs) {
+    uint64_t deadline = UINT64_MAX;
+
+    if (inputs) {
+        deadline = MIN(deadline, ztl_digital_input__engine_pass());
+#if defined(CONFIG_ZTL_KEYPAD)
+        deadline = MIN(deadline, ztl_keypad__engine_pass());
+#endif
+    }
+    if (outputs) {
+        deadline = MIN(deadline, ztl_digital_output__engine_pass());
+    }
+
+    return deadline;
+}
+
+#if defined(CONFIG_ZTL_IO_ENGINE_SYSTEM_WORKQUEUE)
+
+static void engine_work_handler(struct k_work* work);
+
+K_WORK_DELAYABLE_DEFINE(g_engine_work, engine_work_handler);
+
+static void engine_work_handler(struct k_work* const work) {
+    uint64_t const deadline = run_pass(true, true);
+
+    if (UINT64_MAX != deadline) {
+        // No effect when a wakeup already queued the work again
+        k_work_schedule(&g_engine_work, ztl_time__timeout_until_us(deadline));
+    }
+}
+
+void ztl_io_engine__wakeup(enum ZtlIoEngineClient const client) {
+    k_work_reschedule(&g_engine_work, K_NO_WAIT);
+}
+
+#else
+
+#if defined(CONFIG_ZTL_IO_ENGINE_SHARED_THREAD)
+enum {
+    ENGINE_COUNT = 1,
+};
+#else
+enum {
+    ENGINE_COUNT = 2,
+};
+#endif
+
+typedef struct Engine {
+    struct k_thread thread;
+    struct k_sem wakeup;
+    bool inputs;
+    bool outputs;
+    char const* name;
+} Engine;
+
+static struct Engine g_engines[ENGINE_COUNT] = {
+#if defined(CONFIG_ZTL_IO_ENGINE_SHARED_THREAD)
+    {.inputs = true, .outputs = true, .name = "ztl_io"},
+#else
+    {.inputs = true, .outputs = false, .name = "ztl_inputs"},
+    {.inputs = false, .outputs = true, .name = "ztl_outputs"},
+#endif
+};
+
+K_THREAD_STACK_ARRAY_DEFINE(g_engine_stacks, ENGINE_COUNT, CONFIG_ZTL_IO_ENGINE_STACK_SIZE);
+
+static void engine_loop(void* arg1, void* arg2, void* arg3) {
+    struct Engine* const self = arg1;
+
+    while (true) {
+        uint64_t const deadline = run_pass(self->inputs, self->outputs);
+
+        k_timeout_t timeout = K_FOREVER;
+        if (UINT64_MAX != deadline) {
+            timeout = ztl_time__timeout_until_us(deadline);
+        }
+        k_sem_take(&self->wakeup, timeout);
+    }
+}
+
+void ztl_io_engine__wakeup(enum ZtlIoEngineClient const client) {
+    uint8_t const idx = (ENGINE_COUNT > 1 && ZTL_IO_ENGINE_CLIENT__OUTPUTS == client) ? 1 : 0;
+    k_sem_give(&g_engines[idx].wakeup);
+}
+
+static int init_engines(void) {
+    for (uint8_t i = 0; i < ENGINE_COUNT; i++) {
+        struct Engine* const self = &g_engines[i];
+
+        k_sem_init(&self->wakeup, 0, 1);
+        k_tid_t const tid = k_thread_create(&self->thread, g_engine_stacks[i], K_THREAD_STACK_SIZEOF(g_engine_stacks[i]),
+                                            engine_loop, self, NULL, NULL,
+                                            CONFIG_ZTL_IO_ENGINE_PRIORITY, 0, K_FOREVER);
+        k_thread_name_set(tid, self->name);
+#if defined(CONFIG_ZTL_IO_ENGINE_CPU)
+        if (CONFIG_ZTL_IO_ENGINE_CPU >= 0) {
+            k_thread_cpu_pin(tid, CONFIG_ZTL_IO_ENGINE_CPU);
+        }
+#endif
+        k_thread_start(tid);
+    }
+
+    return 0;
+}
+
+// Ahead of the APPLICATION level where the devicetree objects register
+SYS_INIT(init_engines, POST_KERNEL, CONFIG_KERNEL_INIT_PRIORITY_DEFAULT);
+
+#endif
+
+#if defined(CONFIG_ZTL_FOOTPRINT_REPORT)
+GEN_ABS_SYM_BEGIN(ztl_io_engine_footprint)
+#if defined(CONFIG_ZTL_IO_ENGINE_SYSTEM_WORKQUEUE)
+GEN_ABSOLUTE_SYM(ztl_sizeof_io_engine_stacks, 0);
+#else
+GEN_ABSOLUTE_SYM(ztl_sizeof_io_engine_stacks, sizeof(g_engine_stacks));
+#endif
+GEN_ABS_SYM_END
+#endif
@@ -0,0 +1,27 @@
+#ifndef ZTL_IO_ENGINE_H_
+#define ZTL_IO_ENGINE_H_
+
+#include <zephyr/types.h>
+
+// Context the input and output engines run from, see ZTL_IO_ENGINE in Kconfig.
+// Internal to the library.
+
+typedef enum ZtlIoEngineClient {
+    ZTL_IO_ENGINE_CLIENT__INPUTS = 0,
+    ZTL_IO_ENGINE_CLIENT__OUTPUTS = 1,
+} ZtlIoEngineClient;
+
+// Runs a pass of the client engine as soon as possible, ISR safe
+void ztl_io_engine__wakeup(enum ZtlIoEngineClient client);
+
+// Engine passes, each one handles what is due and returns its next
+// deadline on the time base, UINT64_MAX when it only waits for a wakeup
+uint64_t ztl_digital_input__engine_pass(void);
+uint64_t ztl_digital_output__engine_pass(void);
+
+#if defined(CONFIG_ZTL_KEYPAD)
+// Keypads are scanned along with the inputs
+uint64_t ztl_keypad__engine_pass(void);
+#endif
+
+#endif // ZTL_IO_ENGINE_H_
@@ -0,0 +1,486 @@
+#include "keypad.h"
+#include "io_engine.h"
+#include "time.h"
+
+#include <lib/safe-c/safe_c.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/toolchain.h>
+#include <zephyr/sys/math_extras.h>
+
+BUILD_ASSERT(CONFIG_ZTL_KEYPAD_MAX_ROWS <= 32, "Rows of a column must fit the 32-bit vertical counters");
+
+K_MUTEX_DEFINE(g_keypads_mutex);
+static struct ZtlKeypad* g_keypads[CONFIG_ZTL_KEYPAD_MAX_COUNT] = {0};
+
+static uint8_t register_port(
+    struct ZtlKeypadPort* const ports,
+    uint8_t* const ports_count,
+    struct gpio_dt_spec const* const gpio)
+{
+    uint8_t idx = 0;
+    while (idx < *ports_count && ports[idx].dev != gpio->port) {
+        idx++;
+    }
+    if (idx == *ports_count) {
+        ports[idx].dev = gpio->port;
+        (*ports_count)++;
+    }
+    ports[idx].mask |= BIT(gpio->pin);
+    if (gpio->dt_flags & GPIO_ACTIVE_LOW) {
+        ports[idx].active_low_mask |= BIT(gpio->pin);
+    }
+
+    return idx;
+}
+
+// Drives the columns of active_columns and releases the others to inputs,
+// two keys down on one row never tie a driven column to another one
+static int drive_columns(struct ZtlKeypad* const self, uint32_t const active_columns) {
+    // Ascending order releases the previous column of a scan before the next is driven
+    uint32_t changed = active_columns ^ self->driven_columns;
+    while (changed) {
+        uint8_t const c = (uint8_t)u32_count_trailing_zeros(changed);
+        changed &= changed - 1;
+
+        TRY(gpio_pin_configure_dt(&self->columns[c], (active_columns & BIT(c)) ? GPIO_OUTPUT_ACTIVE : GPIO_INPUT));
+        self->driven_columns ^= BIT(c);
+    }
+
+    return 0;
+}
+
+// One read per row port, returns the mask of active rows
+static int read_rows(struct ZtlKeypad* const self, uint32_t* const rows) {
+    for (uint8_t i = 0; i < self->row_ports_count; i++) {
+        struct ZtlKeypadPort* const port = &self->row_ports[i];
+        TRY(gpio_port_get_raw(port->dev, &port->raw));
+        port->raw ^= port->active_low_mask;
+    }
+
+    *rows = 0;
+    for (uint8_t r = 0; r < self->row_count; r++) {
+        if (self->row_ports[self->row_port_idx[r]].raw & BIT(self->rows[r].pin)) {
+            *rows |= BIT(r);
+        }
+    }
+
+    return 0;
+}
+
+static int configure_row_interrupts(struct ZtlKeypad* const self, bool const enable) {
+    if (!self->is_row_interrupt) {
+        return 0;
+    }
+    for (uint8_t r = 0; r < self->row_count; r++) {
+        TRY(gpio_pin_interrupt_configure_dt(&self->rows[r], enable ? GPIO_INT_EDGE_TO_ACTIVE : GPIO_INT_DISABLE));
+    }
+
+    return 0;
+}
+
+static void row_edge_callback(struct device const* const port, struct gpio_callback* const cb, gpio_port_pins_t const pins) {
+    struct ZtlKeypadPort* const self = CONTAINER_OF(cb, struct ZtlKeypadPort, gpio_cb);
+
+    atomic_set(&self->keypad->is_wakeup, 1);
+    ztl_io_engine__wakeup(ZTL_IO_ENGINE_CLIENT__INPUTS);
+}
+
+static void notify(struct ZtlKeypad* const self, uint16_t const key, enum ZtlDigitalInputEventType const event, uint64_t const now) {
+    for (uint8_t i = 0; i < CONFIG_ZTL_KEYPAD_MAX_SUBSCRIBERS_COUNT; i++) {
+        struct ZtlKeypadSubscriber* const sub = &self->subscribers[i];
+        if (NULL == sub->callback || key != sub->key) {
+            continue;
+        }
+        if (ZTL_DIGITAL_INPUT_EVENT_TYPE__CHANGE_STATE_TO_ACTIVE_DEBOUNCED == event) {
+            sub->tl_active = now;
+            sub->is_duration_reported = false;
+        }
+        if (sub->events & BIT(event)) {
+            sub->callback(event, sub->arg);
+        }
+    }
+}
+
+static void notify_changes(
+    struct ZtlKeypad* const self,
+    uint8_t const column,
+    uint32_t changed,
+    uint32_t const state,
+    bool const is_debounced,
+    uint64_t const now)
+{
+    while (changed) {
+        uint8_t const row = (uint8_t)u32_count_trailing_zeros(changed);
+        changed &= changed - 1;
+
+        bool const is_active = state & BIT(row);
+        enum ZtlDigitalInputEventType event;
+        if (is_debounced) {
+            event = is_active ? ZTL_DIGITAL_INPUT_EVENT_TYPE__CHANGE_STATE_TO_ACTIVE_DEBOUNCED :
+                                ZTL_DIGITAL_INPUT_EVENT_TYPE__CHANGE_STATE_TO_INACTIVE_DEBOUNCED;
+        } else {
+            event = is_active ? ZTL_DIGITAL_INPUT_EVENT_TYPE__CHANGE_STATE_TO_ACTIVE :
+                                ZTL_DIGITAL_INPUT_EVENT_TYPE__CHANGE_STATE_TO_INACTIVE;
+        }
+        notify(self, (uint16_t)(row * self->column_count + column), event, now);
+    }
+}
+
+// Without diodes, keys down at three corners of a rectangle also close the
+// fourth one. Marks the rows shared by two columns in suspect.
+static bool find_ghosts(struct ZtlKeypad const* const self, uint32_t* const suspect) {
+    bool is_ghosting = false;
+
+    for (uint8_t a = 0; a < self->column_count; a++) {
+        for (uint8_t b = a + 1; b < self->column_count; b++) {
+            uint32_t const common = self->debounce[a].state & self->debounce[b].state;
+            if (common & (common - 1)) {
+                suspect[a] |= common;
+                suspect[b] |= common;
+                is_ghosting = true;
+            }
+        }
+    }
+
+    return is_ghosting;
+}
+
+static void notify_durations(struct ZtlKeypad* const self, uint64_t const now) {
+    for (uint8_t i = 0; i < CONFIG_ZTL_KEYPAD_MAX_SUBSCRIBERS_COUNT; i++) {
+        struct ZtlKeypadSubscriber* const sub = &self->subscribers[i];
+        if (NULL == sub->callback || 0 == sub->active_state_duration_ms || sub->is_duration_reported) {
+            continue;
+        }
+        uint8_t const column = sub->key % self->column_count;
+        uint8_t const row = sub->key / self->column_count;
+        if ((self->pressed[column] & BIT(row)) && now - sub->tl_active >= (uint64_t)sub->active_state_duration_ms * USEC_PER_MSEC) {
+            sub->is_duration_reported = true;
+            sub->callback(ZTL_DIGITAL_INPUT_EVENT_TYPE__ACTIVE_DURATION, sub->arg);
+        }
+    }
+}
+
+static int go_idle(struct ZtlKeypad* const self) {
+    // Any key down now pulls its row active
+    TRY(drive_columns(self, (uint32_t)BIT64_MASK(self->column_count)));
+    TRY(configure_row_interrupts(self, true));
+
+    // A key pressed before the interrupt was armed left no edge
+    uint32_t rows;
+    TRY(read_rows(self, &rows));
+    self->is_scanning = 0 != rows;
+    if (self->is_scanning) {
+        TRY(configure_row_interrupts(self, false));
+    }
+
+    return 0;
+}
+
+static int scan(struct ZtlKeypad* const self, uint64_t const now) {
+    uint32_t samples[CONFIG_ZTL_KEYPAD_MAX_COLUMNS];
+
+    for (uint8_t c = 0; c < self->column_count; c++) {
+        TRY(drive_columns(self, BIT(c)));
+        k_busy_wait(CONFIG_ZTL_KEYPAD_SETTLE_US);
+        TRY(read_rows(self, &samples[c]));
+    }
+    TRY(drive_columns(self, 0));
+    self->stats.scans++;
+
+    // Every key of a column at once
+    bool is_any_down = false;
+    for (uint8_t c = 0; c < self->column_count; c++) {
+        uint32_t rising;
+        uint32_t falling;
+        uint32_t const raw_changed = samples[c] ^ self->raw[c];
+        self->raw[c] = samples[c];
+        ztl_vertical_debounce__update(&self->debounce[c], samples[c], &rising, &falling);
+        is_any_down = is_any_down || samples[c] || self->debounce[c].state;
+        notify_changes(self, c, raw_changed, samples[c], false, now);
+    }
+
+    uint32_t suspect[CONFIG_ZTL_KEYPAD_MAX_COLUMNS] = {0};
+    self->is_ghosting = find_ghosts(self, suspect);
+    if (self->is_ghosting) {
+        self->stats.ghost_scans++;
+    }
+    for (uint8_t c = 0; c < self->column_count; c++) {
+        uint32_t const state = self->debounce[c].state;
+        // Releases always go out, a new press waits while it may be a ghost
+        uint32_t const pressed = (state & ~suspect[c]) | (state & self->pressed[c]);
+        uint32_t const changed = pressed ^ self->pressed[c];
+        self->pressed[c] = pressed;
+        notify_changes(self, c, changed, pressed, true, now);
+    }
+    notify_durations(self, now);
+
+    if (!is_any_down) {
+        TRY(go_idle(self));
+    }
+
+    return 0;
+}
+
+uint64_t ztl_keypad__engine_pass(void) {
+    uint64_t deadline = UINT64_MAX;
+
+    k_mutex_lock(&g_keypads_mutex, K_FOREVER);
+    uint64_t const now = ztl_time__now_us();
+    for (uint8_t i = 0; i < CONFIG_ZTL_KEYPAD_MAX_COUNT; i++) {
+        struct ZtlKeypad* const self = g_keypads[i];
+        if (NULL == self) {
+            continue;
+        }
+
+        if (atomic_cas(&self->is_wakeup, 1, 0) && !self->is_scanning) {
+            (void)configure_row_interrupts(self, false);
+            self->is_scanning = true;
+            self->tl_next_scan = now;
+            self->stats.wakeups++;
+        }
+
+        if (now >= self->tl_next_scan) {
+            if (self->is_scanning) {
+                (void)scan(self, now);
+            } else if (!self->is_row_interrupt) {
+                // Columns stay driven while idle, one row read tells if a key is down
+                uint32_t rows = 0;
+                (void)read_rows(self, &rows);
+                self->is_scanning = 0 != rows;
+            }
+            self->tl_next_scan = now + self->scan_period_us;
+        }
+
+        if (self->is_scanning || !self->is_row_interrupt) {
+            deadline = MIN(deadline, self->tl_next_scan);
+        }
+    }
+    k_mutex_unlock(&g_keypads_mutex);
+
+    return deadline;
+}
+
+// Undoes a failed init, the first callbacks_count row ports have their
+// callback added
+static void release_pins(struct ZtlKeypad* const self, uint8_t const callbacks_count) {
+    if (self->is_row_interrupt) {
+        for (uint8_t r = 0; r < self->row_count; r++) {
+            (void)gpio_pin_interrupt_configure_dt(&self->rows[r], GPIO_INT_DISABLE);
+        }
+    }
+    for (uint8_t i = 0; i < callbacks_count; i++) {
+        (void)gpio_remove_callback(self->row_ports[i].dev, &self->row_ports[i].gpio_cb);
+    }
+    (void)drive_columns(self, 0);
+}
+
+int ztl_keypad__init(
+    struct ZtlKeypad* const self,
+    struct gpio_dt_spec const* const rows,
+    uint8_t const row_count,
+    struct gpio_dt_spec const* const columns,
+    uint8_t const column_count)
+{
+    int rc = 0;
+    uint8_t callbacks_count = 0;
+    ASSERT(NULL != self, ER_INVAL);
+    ASSERT(NULL != rows, ER_INVAL);
+    ASSERT(NULL != columns, ER_INVAL);
+    ASSERT(row_count > 0 && row_count <= CONFIG_ZTL_KEYPAD_MAX_ROWS, ER_INVAL);
+    ASSERT(column_count > 0 && column_count <= CONFIG_ZTL_KEYPAD_MAX_COLUMNS, ER_INVAL);
+
+    memset(self, 0, sizeof(*self));
+    self->rows = rows;
+    self->row_count = row_count;
+    self->columns = columns;
+    self->column_count = column_count;
+    self->scan_period_us = CONFIG_ZTL_KEYPAD_SCAN_PERIOD_US;
+
+    for (uint8_t c = 0; c < column_count; c++) {
+        TRY(gpio_pin_configure_dt(&columns[c], GPIO_INPUT));
+    }
+    for (uint8_t r = 0; r < row_count; r++) {
+        TRY(gpio_pin_configure_dt(&rows[r], GPIO_INPUT));
+        self->row_port_idx[r] = register_port(self->row_ports, &self->row_ports_count, &rows[r]);
+    }
+
+    // Rows are polled while idle unless the controllers of all of them
+    // take an edge interrupt, drivers accept a disable without edge support
+    self->is_row_interrupt = true;
+    for (uint8_t r = 0; r < row_count; r++) {
+        int const irq_rc = gpio_pin_interrupt_configure_dt(&rows[r], GPIO_INT_EDGE_TO_ACTIVE);
+        if (-ENOTSUP == irq_rc || -ENOSYS == irq_rc) {
+            self->is_row_interrupt = false;
+        } else {
+            TRY(irq_rc);
+            TRY(gpio_pin_interrupt_configure_dt(&rows[r], GPIO_INT_DISABLE));
+        }
+    }
+
+    k_mutex_lock(&g_keypads_mutex, K_FOREVER);
+    if (self->is_row_interrupt) {
+        for (; callbacks_count < self->row_ports_count; callbacks_count++) {
+            struct ZtlKeypadPort* const port = &self->row_ports[callbacks_count];
+            port->keypad = self;
+            gpio_init_callback(&port->gpio_cb, row_edge_callback, port->mask);
+            TRY_EX(gpio_add_callback(port->dev, &port->gpio_cb));
+        }
+    }
+
+    uint8_t slot = 0;
+    while (slot < CONFIG_ZTL_KEYPAD_MAX_COUNT && NULL != g_keypads[slot]) {
+        slot++;
+    }
+    ASSERT_EX(slot < CONFIG_ZTL_KEYPAD_MAX_COUNT, ER_NO_MEM);
+    TRY_EX(go_idle(self));
+    self->tl_next_scan = ztl_time__now_us();
+    g_keypads[slot] = self;
+
+ finally:
+
+    if (rc < 0) {
+        release_pins(self, callbacks_count);
+    }
+    k_mutex_unlock(&g_keypads_mutex);
+    ztl_io_engine__wakeup(ZTL_IO_ENGINE_CLIENT__INPUTS);
+
+    return rc;
+}
+
+int ztl_keypad__deinit(struct ZtlKeypad* const self) {
+    int rc = 0;
+    ASSERT(NULL != self, ER_INVAL);
+
+    k_mutex_lock(&g_keypads_mutex, K_FOREVER);
+    uint8_t slot = 0;
+    while (slot < CONFIG_ZTL_KEYPAD_MAX_COUNT && self != g_keypads[slot]) {
+        slot++;
+    }
+    ASSERT_EX(slot < CONFIG_ZTL_KEYPAD_MAX_COUNT, ER_INVAL);
+    g_keypads[slot] = NULL;
+    TRY_EX(configure_row_interrupts(self, false));
+    if (self->is_row_interrupt) {
+        for (uint8_t i = 0; i < self->row_ports_count; i++) {
+            TRY_EX(gpio_remove_callback(self->row_ports[i].dev, &self->row_ports[i].gpio_cb));
+        }
+    }
+    TRY_EX(drive_columns(self, 0));
+
+ finally:
+
+    k_mutex_unlock(&g_keypads_mutex);
+
+    return rc;
+}
+
+int ztl_keypad__set_scan_period_us(struct ZtlKeypad* const self, uint32_t const us) {
+    ASSERT(NULL != self, ER_INVAL);
+    ASSERT(us > 0, ER_INVAL);
+
+    k_mutex_lock(&g_keypads_mutex, K_FOREVER);
+    self->scan_period_us = us;
+    k_mutex_unlock(&g_keypads_mutex);
+
+    return 0;
+}
+
+int ztl_keypad__state(struct ZtlKeypad* const self, uint16_t const key, bool* const state) {
+    ASSERT(NULL != self, ER_INVAL);
+    ASSERT(NULL != state, ER_INVAL);
+    ASSERT(key < self->row_count * self->column_count, ER_INVAL);
+
+    k_mutex_lock(&g_keypads_mutex, K_FOREVER);
+    *state = self->pressed[key % self->column_count] & BIT(key / self->column_count);
+    k_mutex_unlock(&g_keypads_mutex);
+
+    return 0;
+}
+
+int ztl_keypad__is_ghosting(struct ZtlKeypad* const self, bool* const is_ghosting) {
+    ASSERT(NULL != self, ER_INVAL);
+    ASSERT(NULL != is_ghosting, ER_INVAL);
+
+    k_mutex_lock(&g_keypads_mutex, K_FOREVER);
+    *is_ghosting = self->is_ghosting;
+    k_mutex_unlock(&g_keypads_mutex);
+
+    return 0;
+}
+
+int ztl_keypad__stats(struct ZtlKeypad* const self, struct ZtlKeypadStats* const stats) {
+    ASSERT(NULL != self, ER_INVAL);
+    ASSERT(NULL != stats, ER_INVAL);
+
+    k_mutex_lock(&g_keypads_mutex, K_FOREVER);
+    *stats = self->stats;
+    k_mutex_unlock(&g_keypads_mutex);
+
+    return 0;
+}
+
+int ztl_keypad__subscribe(
+    struct ZtlKeypad* const self,
+    uint16_t const key,
+    struct ZtlDigitalInputEventConditions const* const conditions,
+    ZtlDigitalInputCallback const cb,
+    void* arg)
+{
+    int rc = 0;
+    ASSERT(NULL != self, ER_INVAL);
+    ASSERT(NULL != conditions, ER_INVAL);
+    ASSERT(NULL != cb, ER_INVAL);
+    ASSERT(key < self->row_count * self->column_count, ER_INVAL);
+    ASSERT(0 == conditions->inactive_state_duration, ER_INVAL);
+
+    uint8_t events = 0;
+    events |= conditions->change_state_to_active ? BIT(ZTL_DIGITAL_INPUT_EVENT_TYPE__CHANGE_STATE_TO_ACTIVE) : 0;
+    events |= conditions->change_state_to_inactive ? BIT(ZTL_DIGITAL_INPUT_EVENT_TYPE__CHANGE_STATE_TO_INACTIVE) : 0;
+    events |= conditions->change_state_to_active_debounced ? BIT(ZTL_DIGITAL_INPUT_EVENT_TYPE__CHANGE_STATE_TO_ACTIVE_DEBOUNCED) : 0;
+    events |= conditions->change_state_to_inactive_debounced ? BIT(ZTL_DIGITAL_INPUT_EVENT_TYPE__CHANGE_STATE_TO_INACTIVE_DEBOUNCED) : 0;
+    bool const is_removed = 0 == events && 0 == conditions->active_state_duration;
+
+    k_mutex_lock(&g_keypads_mutex, K_FOREVER);
+    struct ZtlKeypadSubscriber* slot = NULL;
+    for (uint8_t i = 0; i < CONFIG_ZTL_KEYPAD_MAX_SUBSCRIBERS_COUNT; i++) {
+        struct ZtlKeypadSubscriber* const sub = &self->subscribers[i];
+        if (cb == sub->callback && key == sub->key) {
+            slot = sub;
+            break;
+        }
+        if (NULL == slot && NULL == sub->callback) {
+            slot = sub;
+        }
+    }
+
+    if (is_removed) {
+        if (slot && cb == slot->callback) {
+            memset(slot, 0, sizeof(*slot));
+        }
+    } else {
+        ASSERT_EX(NULL != slot, ER_NO_MEM);
+        bool const is_new = cb != slot->callback || key != slot->key;
+        slot->callback = cb;
+        slot->arg = arg;
+        slot->key = key;
+        slot->events = events;
+        slot->active_state_duration_ms = conditions->active_state_duration;
+        if (is_new) {
+            // A key already down counts its duration from now
+            slot->tl_active = ztl_time__now_us();
+            slot->is_duration_reported = false;
+        }
+    }
+
+ finally:
+
+    k_mutex_unlock(&g_keypads_mutex);
+
+    return rc;
+}
+
+#if defined(CONFIG_ZTL_FOOTPRINT_REPORT)
+GEN_ABS_SYM_BEGIN(ztl_keypad_footprint)
+GEN_ABSOLUTE_SYM(ztl_sizeof_keypad, sizeof(struct ZtlKeypad));
+GEN_ABS_SYM_END
+#endif
@@ -0,0 +1,107 @@
+#ifndef ZTL_KEYPAD_H_
+#define ZTL_KEYPAD_H_
+
+#include "digital_input.h"
+#include "vertical_debounce.h"
+
+#include <zephyr/drivers/gpio.h>
+#include <zephyr/kernel.h>
+#include <zephyr/sys/atomic.h>
+#include <zephyr/types.h>
+
+// Key matrix scanned by the input engine. Columns are driven active one at
+// a time with the others released to inputs, and the rows read back. Key
+// (row, column) has the index row * column_count + column. Rows need a
+// bias to their inactive level.
+// With no key down the scan stops, all columns stay driven and an edge on
+// a row restarts it. Rows without edge interrupts are polled instead.
+
+struct ZtlKeypad;
+
+// Port holding some rows of a keypad
+typedef struct ZtlKeypadPort {
+    struct device const* dev;
+    gpio_port_pins_t mask;
+    gpio_port_pins_t active_low_mask;
+    gpio_port_value_t raw;
+    struct gpio_callback gpio_cb;
+    struct ZtlKeypad* keypad;
+} ZtlKeypadPort;
+
+typedef struct ZtlKeypadSubscriber {
+    ZtlDigitalInputCallback callback;
+    void* arg;
+    uint16_t key;
+    // Bit per ZtlDigitalInputEventType to report
+    uint8_t events;
+    bool is_duration_reported;
+    uint32_t active_state_duration_ms;
+    // Debounced press of the key
+    uint64_t tl_active;
+} ZtlKeypadSubscriber;
+
+typedef struct ZtlKeypadStats {
+    uint32_t scans;
+    // Scans where keys pressed on two columns share two rows, any of the
+    // four keys of that rectangle may be a ghost
+    uint32_t ghost_scans;
+    // Row edges that restarted the scan
+    uint32_t wakeups;
+} ZtlKeypadStats;
+
+typedef struct ZtlKeypad {
+    struct gpio_dt_spec const* rows;
+    struct gpio_dt_spec const* columns;
+    uint8_t row_count;
+    uint8_t column_count;
+    uint8_t row_ports_count;
+    struct ZtlKeypadPort row_ports[CONFIG_ZTL_KEYPAD_MAX_ROWS];
+    uint8_t row_port_idx[CONFIG_ZTL_KEYPAD_MAX_ROWS];
+    // Columns configured as active outputs, the others are inputs
+    uint32_t driven_columns;
+    uint32_t scan_period_us;
+    bool is_scanning;
+    bool is_row_interrupt;
+    bool is_ghosting;
+    // Set by a row edge, cleared by the engine
+    atomic_t is_wakeup;
+    uint64_t tl_next_scan;
+    // Row masks per column: last sample, debounced state, keys reported as pressed.
+    // A key waits in the debounced state while it may be a ghost.
+    uint32_t raw[CONFIG_ZTL_KEYPAD_MAX_COLUMNS];
+    struct ZtlVerticalDebounce debounce[CONFIG_ZTL_KEYPAD_MAX_COLUMNS];
+    uint32_t pressed[CONFIG_ZTL_KEYPAD_MAX_COLUMNS];
+    struct ZtlKeypadSubscriber subscribers[CONFIG_ZTL_KEYPAD_MAX_SUBSCRIBERS_COUNT];
+    struct ZtlKeypadStats stats;
+} ZtlKeypad;
+
+// Takes the pins, rows are configured as inputs and columns switch between
+// input and output, both with the flags of their specs. The spec arrays
+// must outlive the keypad.
+int ztl_keypad__init(
+    struct ZtlKeypad* self,
+    struct gpio_dt_spec const* rows,
+    uint8_t row_count,
+    struct gpio_dt_spec const* columns,
+    uint8_t column_count);
+int ztl_keypad__deinit(struct ZtlKeypad* self);
+// A key changes its debounced state after 4 equal scans
+int ztl_keypad__set_scan_period_us(struct ZtlKeypad* self, uint32_t us);
+// Debounced state of the key as reported to the subscribers
+int ztl_keypad__state(struct ZtlKeypad* self, uint16_t key, bool* state);
+int ztl_keypad__is_ghosting(struct ZtlKeypad* self, bool* is_ghosting);
+int ztl_keypad__stats(struct ZtlKeypad* self, struct ZtlKeypadStats* stats);
+
+// Same events and conditions as a digital input subscriber, for one key.
+// Subscribing again with the same key and callback replaces the conditions,
+// no condition at all removes the subscriber. Inactive durations are not
+// available, the scan is stopped while all keys are up. Callbacks run from
+// the input engine and delay the next scan, keep them short.
+int ztl_keypad__subscribe(
+    struct ZtlKeypad* self,
+    uint16_t key,
+    struct ZtlDigitalInputEventConditions const* conditions,
+    ZtlDigitalInputCallback cb,
+    void* arg);
+
+#endif // ZTL_KEYPAD_H_
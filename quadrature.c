@@ -0,0 +1,107 @@
+#include "quadrature.h"
+#include "time.h"
+
+#include <lib/safe-c/safe_c.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/toolchain.h>
+
+enum {
+    STEP_INVALID = 2,
+};
+
+// Indexed by previous AB state << 2 | new AB state
+static int8_t const g_steps[16] = {
+    0, -1, 1, STEP_INVALID,
+    1, 0, STEP_INVALID, -1,
+    -1, STEP_INVALID, 0, 1,
+    STEP_INVALID, 1, -1, 0,
+};
+
+void ztl_quadrature__update(struct ZtlQuadrature* const self, bool const a, bool const b) {
+    uint8_t const ab = (a ? 2 : 0) | (b ? 1 : 0);
+
+    k_spinlock_key_t const key = k_spin_lock(&self->lock);
+    int8_t const step = g_steps[(self->prev_ab << 2) | ab];
+    self->prev_ab = ab;
+    k_spin_unlock(&self->lock, key);
+
+    if (STEP_INVALID == step) {
+        atomic_inc(&self->invalid_count);
+    } else if (step) {
+        atomic_add(&self->position, step);
+    }
+}
+
+int ztl_quadrature__init(struct ZtlQuadrature* const self, struct gpio_dt_spec const* const gpio_a, struct gpio_dt_spec const* const gpio_b) {
+    ASSERT(NULL != self, ER_INVAL);
+    ASSERT(NULL != gpio_a, ER_INVAL);
+    ASSERT(NULL != gpio_b, ER_INVAL);
+
+    memset(self, 0, sizeof(*self));
+    TRY(ztl_digital_input__init(&self->a, gpio_a));
+    int const rc = ztl_digital_input__init(&self->b, gpio_b);
+    if (rc < 0) {
+        (void)ztl_digital_input__deinit(&self->a);
+        return rc;
+    }
+    self->prev_ab = (gpio_pin_get_dt(gpio_a) > 0 ? 2 : 0) | (gpio_pin_get_dt(gpio_b) > 0 ? 1 : 0);
+    self->tl_velocity = ztl_time__now_us();
+    TRY(ztl_digital_input__attach_quadrature(&self->a, self));
+    TRY(ztl_digital_input__attach_quadrature(&self->b, self));
+
+    return 0;
+}
+
+int ztl_quadrature__position(struct ZtlQuadrature* const self, int32_t* const position) {
+    ASSERT(NULL != self, ER_INVAL);
+    ASSERT(NULL != position, ER_INVAL);
+
+    *position = (int32_t)atomic_get(&self->position);
+
+    return 0;
+}
+
+int ztl_quadrature__set_position(struct ZtlQuadrature* const self, int32_t const position) {
+    ASSERT(NULL != self, ER_INVAL);
+
+    k_spinlock_key_t const key = k_spin_lock(&self->lock);
+    atomic_set(&self->position, position);
+    self->velocity_position = position;
+    k_spin_unlock(&self->lock, key);
+
+    return 0;
+}
+
+int ztl_quadrature__velocity(struct ZtlQuadrature* const self, int32_t* const counts_per_sec) {
+    ASSERT(NULL != self, ER_INVAL);
+    ASSERT(NULL != counts_per_sec, ER_INVAL);
+
+    k_spinlock_key_t const key = k_spin_lock(&self->lock);
+    uint64_t const now = ztl_time__now_us();
+    int32_t const position = (int32_t)atomic_get(&self->position);
+    uint64_t const elapsed_us = now - self->tl_velocity;
+    int32_t const delta = position - self->velocity_position;
+    self->velocity_position = position;
+    self->tl_velocity = now;
+    k_spin_unlock(&self->lock, key);
+
+    *counts_per_sec = elapsed_us ? (int32_t)((int64_t)delta * USEC_PER_SEC / (int64_t)elapsed_us) : 0;
+
+    return 0;
+}
+
+int ztl_quadrature__invalid_count(struct ZtlQuadrature* const self, uint32_t* const count) {
+    ASSERT(NULL != self, ER_INVAL);
+    ASSERT(NULL != count, ER_INVAL);
+
+    *count = (uint32_t)atomic_get(&self->invalid_count);
+
+    return 0;
+}
+
+#if defined(CONFIG_ZTL_FOOTPRINT_REPORT)
+GEN_ABS_SYM_BEGIN(ztl_quadrature_footprint)
+GEN_ABSOLUTE_SYM(ztl_sizeof_quadrature, sizeof(struct ZtlQuadrature));
+GEN_ABS_SYM_END
+#endif
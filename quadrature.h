@@ -0,0 +1,37 @@
+#ifndef ZTL_QUADRATURE_H_
+#define ZTL_QUADRATURE_H_
+
+#include "digital_input.h"
+
+#include <zephyr/drivers/gpio.h>
+#include <zephyr/kernel.h>
+#include <zephyr/sys/atomic.h>
+#include <zephyr/types.h>
+
+// Quadrature encoder on two digital inputs. Transitions are decoded from
+// the edge ISR when the inputs use edge capture, from the port snapshots
+// of the input scan otherwise.
+typedef struct ZtlQuadrature {
+    struct ZtlDigitalInput a;
+    struct ZtlDigitalInput b;
+    struct k_spinlock lock;
+    uint8_t prev_ab;
+    atomic_t position;
+    atomic_t invalid_count;
+    // Last velocity query
+    int32_t velocity_position;
+    uint64_t tl_velocity;
+} ZtlQuadrature;
+
+int ztl_quadrature__init(struct ZtlQuadrature* self, struct gpio_dt_spec const* gpio_a, struct gpio_dt_spec const* gpio_b);
+int ztl_quadrature__position(struct ZtlQuadrature* self, int32_t* position);
+int ztl_quadrature__set_position(struct ZtlQuadrature* self, int32_t position);
+// Counts per second since the previous velocity query
+int ztl_quadrature__velocity(struct ZtlQuadrature* self, int32_t* counts_per_sec);
+// Transitions where both channels changed at once, so the direction is unknown
+int ztl_quadrature__invalid_count(struct ZtlQuadrature* self, uint32_t* count);
+
+// Called by the input engine with the current levels of both channels
+void ztl_quadrature__update(struct ZtlQuadrature* self, bool a, bool b);
+
+#endif // ZTL_QUADRATURE_H_
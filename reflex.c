@@ -0,0 +1,78 @@
+#include "reflex.h"
+
+#include <lib/safe-c/safe_c.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/toolchain.h>
+
+void ztl_reflex__fire(struct ZtlReflex* const reflexes, enum ZtlDigitalInputEventType const event, uint32_t const start_cyc) {
+    for (struct ZtlReflex* self = reflexes; self; self = self->next) {
+        if (event != self->event) {
+            continue;
+        }
+
+        ztl_digital_output__reflex(self->output, self->action, self->pulse_count, self->is_direct);
+
+        // Unsigned difference stays right across a counter wrap
+        uint32_t const cyc = k_cycle_get_32() - start_cyc;
+        self->last_cyc = cyc;
+        self->max_cyc = MAX(self->max_cyc, cyc);
+        atomic_inc(&self->count);
+    }
+}
+
+int ztl_reflex__bind(
+    struct ZtlReflex* const self,
+    struct ZtlDigitalInput* const input,
+    enum ZtlDigitalInputEventType const event,
+    struct ZtlDigitalOutput* const output,
+    enum ZtlReflexAction const action,
+    int32_t const pulse_count)
+{
+    ASSERT(NULL != self, ER_INVAL);
+    ASSERT(NULL != input, ER_INVAL);
+    ASSERT(NULL != output, ER_INVAL);
+    ASSERT(event <= ZTL_DIGITAL_INPUT_EVENT_TYPE__CHANGE_STATE_TO_INACTIVE_DEBOUNCED, ER_INVAL);
+    ASSERT(action <= ZTL_REFLEX_ACTION__START_PULSE, ER_INVAL);
+
+    memset(self, 0, sizeof(*self));
+    self->output = output;
+    self->event = event;
+    self->action = action;
+    self->pulse_count = pulse_count;
+    TRY(ztl_digital_input__attach_reflex(input, self));
+
+    return 0;
+}
+
+int ztl_reflex__unbind(struct ZtlReflex* const self, struct ZtlDigitalInput* const input) {
+    ASSERT(NULL != self, ER_INVAL);
+    ASSERT(NULL != input, ER_INVAL);
+
+    return ztl_digital_input__detach_reflex(input, self);
+}
+
+int ztl_reflex__set_direct(struct ZtlReflex* const self, bool const is_direct) {
+    ASSERT(NULL != self, ER_INVAL);
+
+    self->is_direct = is_direct;
+
+    return 0;
+}
+
+int ztl_reflex__stats(struct ZtlReflex* const self, struct ZtlReflexStats* const stats) {
+    ASSERT(NULL != self, ER_INVAL);
+    ASSERT(NULL != stats, ER_INVAL);
+
+    stats->count = (uint32_t)atomic_get(&self->count);
+    stats->last_us = k_cyc_to_us_ceil32(self->last_cyc);
+    stats->max_us = k_cyc_to_us_ceil32(self->max_cyc);
+
+    return 0;
+}
+
+#if defined(CONFIG_ZTL_FOOTPRINT_REPORT)
+GEN_ABS_SYM_BEGIN(ztl_reflex_footprint)
+GEN_ABSOLUTE_SYM(ztl_sizeof_reflex, sizeof(struct ZtlReflex));
+GEN_ABS_SYM_END
+#endif
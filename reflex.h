@@ -0,0 +1,74 @@
+#ifndef ZTL_REFLEX_H_
+#define ZTL_REFLEX_H_
+
+#include "digital_input.h"
+#include "digital_output.h"
+
+#include <zephyr/sys/atomic.h>
+#include <zephyr/types.h>
+
+typedef enum ZtlReflexAction {
+    // Drive the output active or inactive, a running waveform is stopped
+    ZTL_REFLEX_ACTION__SET = 0,
+    ZTL_REFLEX_ACTION__CLEAR = 1,
+    // Invert the set state, a running waveform is stopped
+    ZTL_REFLEX_ACTION__TOGGLE = 2,
+    // Start pulse_count pulses with the output settings
+    ZTL_REFLEX_ACTION__START_PULSE = 3,
+} ZtlReflexAction;
+
+// Binds an edge event of an input to an output action without a callback.
+// Raw edges of inputs with edge capture act from the edge ISR, other
+// events from the input scan pass that detects them, ahead of the
+// subscribers. Actions are queued to the output engine, see
+// ztl_reflex__set_direct() for writes without that delay.
+typedef struct ZtlReflex {
+    struct ZtlDigitalOutput* output;
+    enum ZtlDigitalInputEventType event;
+    enum ZtlReflexAction action;
+    int32_t pulse_count;
+    // SET, CLEAR and TOGGLE also write the pin where they fire
+    bool is_direct;
+    // Next binding of the same input, NULL at the end
+    struct ZtlReflex* next;
+
+    // Reaction times in hardware cycles
+    atomic_t count;
+    uint32_t last_cyc;
+    uint32_t max_cyc;
+} ZtlReflex;
+
+typedef struct ZtlReflexStats {
+    uint32_t count;
+    // From the edge ISR entry, or the start of the scan pass, to the output
+    // write. The time before the ISR runs can't be seen from software.
+    uint32_t last_us;
+    uint32_t max_us;
+} ZtlReflexStats;
+
+// Only CHANGE_STATE_TO_* events can be bound, pulse_count is used by START_PULSE
+int ztl_reflex__bind(
+    struct ZtlReflex* self,
+    struct ZtlDigitalInput* input,
+    enum ZtlDigitalInputEventType event,
+    struct ZtlDigitalOutput* output,
+    enum ZtlReflexAction action,
+    int32_t pulse_count);
+int ztl_reflex__unbind(struct ZtlReflex* self, struct ZtlDigitalInput* input);
+// After bind. SET, CLEAR and TOGGLE write the pin right away, from the edge
+// ISR for captured raw edges, and the output engine takes over the new
+// state. Only for outputs on a port that can be written from interrupts,
+// such as SoC GPIO, not I2C or SPI expanders. PWM and shift-register
+// outputs always go through the queue.
+int ztl_reflex__set_direct(struct ZtlReflex* self, bool is_direct);
+int ztl_reflex__stats(struct ZtlReflex* self, struct ZtlReflexStats* stats);
+
+// Called by the input engine for the bindings of one input, from the edge
+// ISR or the scan pass. start_cyc is the k_cycle_get_32() of the detection.
+void ztl_reflex__fire(struct ZtlReflex* reflexes, enum ZtlDigitalInputEventType event, uint32_t start_cyc);
+
+// Applies the action on the output, ISR safe. is_direct also writes the pin
+// on the spot, the caller vouches for its port.
+void ztl_digital_output__reflex(struct ZtlDigitalOutput* self, enum ZtlReflexAction action, int32_t pulse_count, bool is_direct);
+
+#endif // ZTL_REFLEX_H_
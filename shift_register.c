@@ -0,0 +1,295 @@
+#include "shift_register.h"
+
+#include <lib/safe-c/safe_c.h>
+
+#include <zephyr/device.h>
+#include <zephyr/devicetree.h>
+#include <zephyr/drivers/gpio.h>
+#include <zephyr/drivers/gpio/gpio_utils.h>
+#include <zephyr/drivers/spi.h>
+#include <zephyr/kernel.h>
+#include <zephyr/sys/atomic.h>
+
+enum {
+    PORT_BYTES = 4,
+};
+
+typedef struct ChainConfig {
+    struct spi_dt_spec spi;
+    // SH/LD of the 74HC165s, latches the parallel inputs before a transfer
+    struct gpio_dt_spec load;
+    bool has_load;
+    uint8_t in_bytes;
+    uint8_t out_bytes;
+} ChainConfig;
+
+// Frame byte N is chip N counted from the MCU. 74HC595 latch on the rising
+// chip select at the end of the transfer.
+typedef struct ChainData {
+    struct k_mutex lock;
+    uint8_t* in_frame;
+    uint8_t* out_frame;
+    bool is_in_stale;
+    bool is_out_dirty;
+} ChainData;
+
+typedef struct PortConfig {
+    // Must be first, used by the gpio core
+    struct gpio_driver_config common;
+    struct device const* chain;
+    // Chip of pins 0 to 7
+    uint8_t first_chip;
+} PortConfig;
+
+typedef struct PortData {
+    // Must be first, used by the gpio core
+    struct gpio_driver_data common;
+    gpio_port_pins_t outputs;
+} PortData;
+
+// Batches in progress, see ztl_shift_register__batch_begin()
+static atomic_t g_batch_depth = ATOMIC_INIT(0);
+
+// Clocks the output frame out and the input frame in. Call under the chain lock.
+static int chain_transfer(struct device const* const chain) {
+    ChainConfig const* const config = chain->config;
+    ChainData* const data = chain->data;
+
+    if (config->has_load) {
+        TRY(gpio_pin_set_dt(&config->load, 1));
+        TRY(gpio_pin_set_dt(&config->load, 0));
+    }
+
+    // Both directions share one frame of the longer length. Output bytes go
+    // at its end, the bytes sent before them are pushed out of the last
+    // 74HC595. The first byte received is the 74HC165 next to the MCU.
+    uint8_t const len = MAX(config->in_bytes, config->out_bytes);
+    uint8_t tx_frame[MAX(len, 1)];
+    uint8_t rx_frame[MAX(len, 1)];
+    memset(tx_frame, 0, len - config->out_bytes);
+    for (uint8_t i = 0; i < config->out_bytes; i++) {
+        tx_frame[len - 1 - i] = data->out_frame[i];
+    }
+
+    struct spi_buf tx_buf = {.buf = tx_frame, .len = len};
+    struct spi_buf rx_buf = {.buf = rx_frame, .len = len};
+    struct spi_buf_set const tx = {.buffers = &tx_buf, .count = 1};
+    struct spi_buf_set const rx = {.buffers = &rx_buf, .count = 1};
+    TRY(spi_transceive_dt(&config->spi, &tx, &rx));
+    memcpy(data->in_frame, rx_frame, config->in_bytes);
+
+    data->is_in_stale = false;
+    data->is_out_dirty = false;
+
+    return 0;
+}
+
+static inline uint32_t frame_get(uint8_t const* const frame, uint8_t const len, uint8_t const first) {
+    uint32_t value = 0;
+    for (uint8_t i = 0; i < PORT_BYTES && first + i < len; i++) {
+        value |= (uint32_t)frame[first + i] << (8 * i);
+    }
+    return value;
+}
+
+static int port_get_raw(struct device const* const port, gpio_port_value_t* const value) {
+    int rc = 0;
+    PortConfig const* const config = port->config;
+    PortData const* const port_data = port->data;
+    ChainConfig const* const chain_config = config->chain->config;
+    ChainData* const data = config->chain->data;
+
+    k_mutex_lock(&data->lock, K_FOREVER);
+    if (data->is_in_stale || 0 == atomic_get(&g_batch_depth)) {
+        TRY_EX(chain_transfer(config->chain));
+    }
+    uint32_t const in = frame_get(data->in_frame, chain_config->in_bytes, config->first_chip);
+    uint32_t const out = frame_get(data->out_frame, chain_config->out_bytes, config->first_chip);
+    *value = (in & ~port_data->outputs) | (out & port_data->outputs);
+
+ finally:
+
+    k_mutex_unlock(&data->lock);
+
+    return rc;
+}
+
+static int port_set_masked_raw(struct device const* const port, gpio_port_pins_t const mask, gpio_port_value_t const value) {
+    int rc = 0;
+    PortConfig const* const config = port->config;
+    ChainConfig const* const chain_config = config->chain->config;
+    ChainData* const data = config->chain->data;
+
+    k_mutex_lock(&data->lock, K_FOREVER);
+    for (uint8_t i = 0; i < PORT_BYTES && config->first_chip + i < chain_config->out_bytes; i++) {
+        uint8_t const byte_mask = (uint8_t)(mask >> (8 * i));
+        uint8_t* const byte = &data->out_frame[config->first_chip + i];
+        *byte = (*byte & ~byte_mask) | ((uint8_t)(value >> (8 * i)) & byte_mask);
+    }
+    data->is_out_dirty = true;
+    if (0 == atomic_get(&g_batch_depth)) {
+        TRY_EX(chain_transfer(config->chain));
+    }
+
+ finally:
+
+    k_mutex_unlock(&data->lock);
+
+    return rc;
+}
+
+static int port_set_bits_raw(struct device const* const port, gpio_port_pins_t const pins) {
+    return port_set_masked_raw(port, pins, pins);
+}
+
+static int port_clear_bits_raw(struct device const* const port, gpio_port_pins_t const pins) {
+    return port_set_masked_raw(port, pins, 0);
+}
+
+static int port_toggle_bits(struct device const* const port, gpio_port_pins_t const pins) {
+    PortConfig const* const config = port->config;
+    ChainConfig const* const chain_config = config->chain->config;
+    ChainData* const data = config->chain->data;
+
+    // Recursive lock, the write below happens against the same frame
+    k_mutex_lock(&data->lock, K_FOREVER);
+    uint32_t const out = frame_get(data->out_frame, chain_config->out_bytes, config->first_chip);
+    int const rc = port_set_masked_raw(port, pins, ~out);
+    k_mutex_unlock(&data->lock);
+
+    return rc;
+}
+
+static int pin_configure(struct device const* const port, gpio_pin_t const pin, gpio_flags_t const flags) {
+    PortConfig const* const config = port->config;
+    PortData* const port_data = port->data;
+    ChainConfig const* const chain_config = config->chain->config;
+    uint8_t const chip = config->first_chip + pin / 8;
+
+    // Pulls are external resistors on these chips, their flags are accepted as is
+    ASSERT((flags & (GPIO_INPUT | GPIO_OUTPUT)) != (GPIO_INPUT | GPIO_OUTPUT), -ENOTSUP);
+
+    if (flags & GPIO_OUTPUT) {
+        ASSERT(chip < chain_config->out_bytes, ER_INVAL);
+        port_data->outputs |= BIT(pin);
+        if (flags & GPIO_OUTPUT_INIT_HIGH) {
+            TRY(port_set_masked_raw(port, BIT(pin), BIT(pin)));
+        } else if (flags & GPIO_OUTPUT_INIT_LOW) {
+            TRY(port_set_masked_raw(port, BIT(pin), 0));
+        }
+    } else if (flags & GPIO_INPUT) {
+        ASSERT(chip < chain_config->in_bytes, ER_INVAL);
+        port_data->outputs &= ~BIT(pin);
+    }
+
+    return 0;
+}
+
+// Without pin_interrupt_configure edge capture returns -ENOSYS, the input
+// engine then polls these pins
+static struct gpio_driver_api const g_port_api = {
+    .pin_configure = pin_configure,
+    .port_get_raw = port_get_raw,
+    .port_set_masked_raw = port_set_masked_raw,
+    .port_set_bits_raw = port_set_bits_raw,
+    .port_clear_bits_raw = port_clear_bits_raw,
+    .port_toggle_bits = port_toggle_bits,
+};
+
+static int init_chain(struct device const* const chain) {
+    int rc = 0;
+    ChainConfig const* const config = chain->config;
+    ChainData* const data = chain->data;
+
+    k_mutex_init(&data->lock);
+    ASSERT(spi_is_ready_dt(&config->spi), -ENODEV);
+    if (config->has_load) {
+        ASSERT(gpio_is_ready_dt(&config->load), -ENODEV);
+        TRY(gpio_pin_configure_dt(&config->load, GPIO_OUTPUT_INACTIVE));
+    }
+
+    // Drives every 74HC595 output low from boot
+    k_mutex_lock(&data->lock, K_FOREVER);
+    TRY_EX(chain_transfer(chain));
+
+ finally:
+
+    k_mutex_unlock(&data->lock);
+
+    return rc;
+}
+
+#define CHAIN_NAME(node_id, suffix) UTIL_CAT(UTIL_CAT(ztl_shift_register_chain_, DT_DEP_ORD(node_id)), suffix)
+
+#define CHAIN_DEFINE(node_id)                                                                       \
+    static uint8_t CHAIN_NAME(node_id, _in)[MAX(1, DT_PROP(node_id, input_bytes))];                 \
+    static uint8_t CHAIN_NAME(node_id, _out)[MAX(1, DT_PROP(node_id, output_bytes))];               \
+    static ChainData CHAIN_NAME(node_id, _data) = {                                                 \
+        .in_frame = CHAIN_NAME(node_id, _in),                                                       \
+        .out_frame = CHAIN_NAME(node_id, _out),                                                     \
+        .is_in_stale = true,                                                                        \
+    };                                                                                              \
+    static ChainConfig const CHAIN_NAME(node_id, _config) = {                                       \
+        .spi = SPI_DT_SPEC_GET(node_id, SPI_OP_MODE_MASTER | SPI_WORD_SET(8) | SPI_TRANSFER_MSB, 0), \
+        .load = GPIO_DT_SPEC_GET_OR(node_id, load_gpios, {0}),                                      \
+        .has_load = DT_NODE_HAS_PROP(node_id, load_gpios),                                          \
+        .in_bytes = DT_PROP(node_id, input_bytes),                                                  \
+        .out_bytes = DT_PROP(node_id, output_bytes),                                                \
+    };                                                                                              \
+    DEVICE_DT_DEFINE(node_id, init_chain, NULL, &CHAIN_NAME(node_id, _data),                        \
+                     &CHAIN_NAME(node_id, _config), POST_KERNEL,                                    \
+                     CONFIG_ZTL_SHIFT_REGISTER_INIT_PRIORITY, NULL);
+
+#define PORT_DEFINE(node_id)                                                                        \
+    static PortData CHAIN_NAME(node_id, _port_data);                                                \
+    static PortConfig const CHAIN_NAME(node_id, _port_config) = {                                   \
+        .common = {.port_pin_mask = GPIO_PORT_PIN_MASK_FROM_DT_NODE(node_id)},                      \
+        .chain = DEVICE_DT_GET(DT_PARENT(node_id)),                                                 \
+        .first_chip = DT_REG_ADDR(node_id) * PORT_BYTES,                                            \
+    };                                                                                              \
+    DEVICE_DT_DEFINE(node_id, NULL, NULL, &CHAIN_NAME(node_id, _port_data),                         \
+                     &CHAIN_NAME(node_id, _port_config), POST_KERNEL,                               \
+                     CONFIG_ZTL_SHIFT_REGISTER_INIT_PRIORITY, &g_port_api);
+
+#define CHAIN_REF(node_id) DEVICE_DT_GET(node_id),
+
+DT_FOREACH_STATUS_OKAY(ztl_shift_register_chain, CHAIN_DEFINE)
+DT_FOREACH_STATUS_OKAY(ztl_shift_register_port, PORT_DEFINE)
+
+static struct device const* const g_chains[] = {
+    DT_FOREACH_STATUS_OKAY(ztl_shift_register_chain, CHAIN_REF)
+};
+
+void ztl_shift_register__batch_begin(void) {
+    atomic_inc(&g_batch_depth);
+    for (size_t i = 0; i < ARRAY_SIZE(g_chains); i++) {
+        ChainData* const data = g_chains[i]->data;
+        k_mutex_lock(&data->lock, K_FOREVER);
+        data->is_in_stale = true;
+        k_mutex_unlock(&data->lock);
+    }
+}
+
+int ztl_shift_register__batch_end(void) {
+    int rc = 0;
+
+    // Staged writes go out now, even when another batch is still open
+    for (size_t i = 0; i < ARRAY_SIZE(g_chains); i++) {
+        ChainData* const data = g_chains[i]->data;
+        k_mutex_lock(&data->lock, K_FOREVER);
+        if (data->is_out_dirty) {
+            int const chain_rc = chain_transfer(g_chains[i]);
+            if (chain_rc < 0) {
+                rc = chain_rc;
+            }
+        }
+        k_mutex_unlock(&data->lock);
+    }
+    atomic_dec(&g_batch_depth);
+
+    return rc;
+}
+
+bool ztl_shift_register__is_port(struct device const* const dev) {
+    return &g_port_api == dev->api;
+}
@@ -0,0 +1,21 @@
+#ifndef ZTL_SHIFT_REGISTER_H_
+#define ZTL_SHIFT_REGISTER_H_
+
+#include <zephyr/device.h>
+
+// Chains of 74HC165 input and 74HC595 output shift registers on SPI, seen
+// as GPIO ports of 32 lines (ztl,shift-register-chain and
+// ztl,shift-register-port nodes). Inputs and outputs use their pins like
+// any other gpio_dt_spec, without edge interrupts.
+
+// Port accesses between begin and end share the chain transfers: the first
+// read of a chain clocks its inputs in, later reads use that frame, writes
+// are clocked out once at end. Outside of a batch every port access is a
+// transfer of its own. Used by the input and output engines around a pass.
+void ztl_shift_register__batch_begin(void);
+int ztl_shift_register__batch_end(void);
+
+// Whether dev is a ztl,shift-register-port, whose accesses may block
+bool ztl_shift_register__is_port(struct device const* dev);
+
+#endif // ZTL_SHIFT_REGISTER_H_
@@ -0,0 +1,355 @@
+#include "../../../digital_input.h"
+#include "../../../digital_output.h"
+#include "../../../time.h"
+
+#include <zephyr/devicetree.h>
+#include <zephyr/drivers/gpio.h>
+#include <zephyr/drivers/gpio/gpio_emul.h>
+#include <zephyr/kernel.h>
+#include <zephyr/sys/printk.h>
+#include <zephyr/sys/util.h>
+#include <zephyr/ztest.h>
+
+#include <stdlib.h>
+
+// Times are ztl_time__now_us(), simulated time on native_sim. Code runs in
+// zero simulated time there, pass durations and callback costs only mean
+// something when the suite runs on a board.
+
+#define USER_NODE DT_PATH(zephyr_user)
+#define GPIO_SPEC(node_id, prop, idx) GPIO_DT_SPEC_GET_BY_IDX(node_id, prop, idx),
+
+enum {
+    INPUT_COUNT = DT_PROP_LEN(USER_NODE, input_gpios),
+    OUTPUT_COUNT = DT_PROP_LEN(USER_NODE, output_gpios),
+    SUBSCRIBER_COUNT = CONFIG_ZTL_DIGITAL_INPUT_MAX_SUBSCRIBERS_COUNT,
+
+    // Two ticks, sleeps and engine deadlines round to ticks
+    SLACK_US = 2 * USEC_PER_SEC / CONFIG_SYS_CLOCK_TICKS_PER_SEC,
+    SAMPLE_PERIOD_US = 1000,
+    DEBOUNCE_US = 5000,
+
+    EDGE_COUNT = 20,
+    EDGE_SPACING_US = 2000,
+    // Moves each edge to another phase of the sample period
+    EDGE_PHASE_STEP_US = 137,
+
+    BURST_COUNT = 6,
+    // Odd, a burst settles on the other level
+    BOUNCE_EDGES = 9,
+    BOUNCE_GAP_MIN_US = 50,
+    BOUNCE_GAP_SPREAD_US = 400,
+
+    PULSE_COUNT = 10,
+    PULSE_PERIOD_US = 2000,
+    PULSE_ON_US = 500,
+    POLL_US = 10,
+    // Both edges of a measured interval are off by a poll and a late pass
+    PULSE_BOUND_US = 2 * (2 * POLL_US + SLACK_US),
+
+    SCALE_TOGGLES = 10,
+    SCALE_GAP_US = 3000,
+    SCALE_PERIOD_US = 1000,
+    SCALE_ON_US = 300,
+};
+
+BUILD_ASSERT(INPUT_COUNT == CONFIG_ZTL_DIGITAL_INPUT_MAX_COUNT, "Scaling goes up to the input count of prj.conf");
+BUILD_ASSERT(OUTPUT_COUNT == CONFIG_ZTL_DIGITAL_OUTPUT_MAX_COUNT, "Scaling goes up to the output count of prj.conf");
+
+// One JSON object per line, collected by the record regex of testcase.yaml
+#define RESULT(fmt, ...) printk("ZTL_RESULT {" fmt "}\n", __VA_ARGS__)
+
+// What a subscriber callback saw
+typedef struct Probe {
+    struct k_sem sem;
+    atomic_t calls;
+    uint64_t tl_last;
+    enum ZtlDigitalInputEventType last_event;
+} Probe;
+
+static struct gpio_dt_spec const g_input_gpios[] = {
+    DT_FOREACH_PROP_ELEM(USER_NODE, input_gpios, GPIO_SPEC)
+};
+static struct gpio_dt_spec const g_output_gpios[] = {
+    DT_FOREACH_PROP_ELEM(USER_NODE, output_gpios, GPIO_SPEC)
+};
+
+static struct ZtlDigitalInput g_inputs[INPUT_COUNT];
+static struct Probe g_probes[INPUT_COUNT][SUBSCRIBER_COUNT];
+
+static struct ZtlDigitalOutput g_outputs[OUTPUT_COUNT];
+static struct ZtlDigitalOutput* g_output_refs[OUTPUT_COUNT];
+static struct ZtlDigitalOutputGroup g_group;
+
+static void record(enum ZtlDigitalInputEventType const event, void* const arg) {
+    Probe* const probe = arg;
+
+    probe->tl_last = ztl_time__now_us();
+    probe->last_event = event;
+    atomic_inc(&probe->calls);
+    k_sem_give(&probe->sem);
+}
+
+// A subscriber slot per callback, subscribing the same one again replaces it
+#define SUBSCRIBER_DEFINE(n, _)                                                 \
+    static void subscriber_##n(enum ZtlDigitalInputEventType event, void* arg) { \
+        record(event, arg);                                                     \
+    }
+#define SUBSCRIBER_REF(n, _) subscriber_##n
+
+LISTIFY(CONFIG_ZTL_DIGITAL_INPUT_MAX_SUBSCRIBERS_COUNT, SUBSCRIBER_DEFINE, ())
+
+static ZtlDigitalInputCallback const g_subscribers[] = {
+    LISTIFY(CONFIG_ZTL_DIGITAL_INPUT_MAX_SUBSCRIBERS_COUNT, SUBSCRIBER_REF, (,))
+};
+
+static void inject(uint8_t const i, bool const level) {
+    zassert_ok(gpio_emul_input_set(g_input_gpios[i].port, g_input_gpios[i].pin, level ? 1 : 0));
+}
+
+static bool output_level(uint8_t const i) {
+    return gpio_emul_output_get(g_output_gpios[i].port, g_output_gpios[i].pin) > 0;
+}
+
+static struct ZtlDigitalInput* setup_input(uint8_t const i, bool const is_edge_capture) {
+    struct ZtlDigitalInput* const input = &g_inputs[i];
+
+    zassert_ok(ztl_digital_input__set_edge_capture(input, is_edge_capture));
+    for (uint8_t s = 0; s < SUBSCRIBER_COUNT; s++) {
+        Probe* const probe = &g_probes[i][s];
+        k_sem_init(&probe->sem, 0, K_SEM_MAX_LIMIT);
+        atomic_clear(&probe->calls);
+    }
+
+    return input;
+}
+
+// Inputs stay registered for the whole suite, edge captured and idle until
+// a test subscribes to them
+static void* suite_setup(void) {
+    for (uint8_t i = 0; i < INPUT_COUNT; i++) {
+        zassert_ok(ztl_digital_input__init(&g_inputs[i], &g_input_gpios[i]));
+        zassert_ok(ztl_digital_input__set_sample_period_us(&g_inputs[i], SAMPLE_PERIOD_US));
+        zassert_ok(ztl_digital_input__set_debounce_duration_us(&g_inputs[i], DEBOUNCE_US));
+        zassert_ok(ztl_digital_input__set_edge_capture(&g_inputs[i], true));
+    }
+    for (uint8_t i = 0; i < OUTPUT_COUNT; i++) {
+        zassert_ok(ztl_digital_output__init(&g_outputs[i], &g_output_gpios[i]));
+        g_output_refs[i] = &g_outputs[i];
+    }
+    zassert_ok(ztl_digital_output_group__init(&g_group, g_output_refs, OUTPUT_COUNT));
+
+    return NULL;
+}
+
+// Subscribers drop all their conditions, inputs go back low and settle,
+// outputs stop
+static void after(void* const fixture) {
+    ARG_UNUSED(fixture);
+    struct ZtlDigitalInputEventConditions const none = {0};
+
+    zassert_ok(ztl_digital_output_group__stop_pulse(&g_group, BIT_MASK(OUTPUT_COUNT)));
+    for (uint8_t i = 0; i < INPUT_COUNT; i++) {
+        for (uint8_t s = 0; s < SUBSCRIBER_COUNT; s++) {
+            zassert_ok(ztl_digital_input__subscribe(&g_inputs[i], &none, g_subscribers[s], NULL));
+        }
+        zassert_ok(ztl_digital_input__set_edge_capture(&g_inputs[i], true));
+        inject(i, false);
+    }
+    k_usleep(DEBOUNCE_US + 2 * SAMPLE_PERIOD_US);
+}
+
+// Raw edge to callback, each edge at another phase of the sample period
+static void measure_edge_latency(bool const is_edge_capture, uint32_t const bound_us) {
+    struct ZtlDigitalInput* const input = setup_input(0, is_edge_capture);
+    Probe* const probe = &g_probes[0][0];
+    zassert_ok(ztl_digital_input__subscribe_to_state_change(input, true, true, g_subscribers[0], probe));
+
+    uint32_t max_us = 0;
+    uint64_t total_us = 0;
+    for (uint8_t i = 0; i < EDGE_COUNT; i++) {
+        k_usleep(EDGE_SPACING_US + i * EDGE_PHASE_STEP_US);
+        uint64_t const tl_edge = ztl_time__now_us();
+        inject(0, 0 == i % 2);
+        zassert_ok(k_sem_take(&probe->sem, K_USEC(10 * SAMPLE_PERIOD_US)), "edge %u not reported", i);
+        uint32_t const latency_us = (uint32_t)(probe->tl_last - tl_edge);
+        max_us = MAX(max_us, latency_us);
+        total_us += latency_us;
+    }
+
+    RESULT("\"test\":\"edge_latency\",\"edge_capture\":%s,\"edges\":%u,\"latency_us\":{\"avg\":%u,\"max\":%u}",
+           is_edge_capture ? "true" : "false", EDGE_COUNT, (uint32_t)(total_us / EDGE_COUNT), max_us);
+    zassert_equal(atomic_get(&probe->calls), EDGE_COUNT, "edges reported more than once");
+    zassert_true(max_us <= bound_us, "latency %u us over %u us", max_us, bound_us);
+}
+
+ZTEST(io_timing, test_edge_latency_captured) {
+    measure_edge_latency(true, SLACK_US);
+}
+
+ZTEST(io_timing, test_edge_latency_polled) {
+    measure_edge_latency(false, SAMPLE_PERIOD_US + SLACK_US);
+}
+
+// Bursts of bounces shorter than the debounce duration must give one
+// debounced change each, DEBOUNCE_US after the last edge
+ZTEST(io_timing, test_bounce_burst_debounce) {
+    struct ZtlDigitalInput* const input = setup_input(0, true);
+    Probe* const probe = &g_probes[0][0];
+    zassert_ok(ztl_digital_input__subscribe_to_state_change_debounced(input, true, true, g_subscribers[0], probe));
+
+    bool level = false;
+    int32_t error_min_us = INT32_MAX;
+    int32_t error_max_us = INT32_MIN;
+    for (uint8_t b = 0; b < BURST_COUNT; b++) {
+        uint64_t tl_stable = 0;
+        for (uint8_t e = 0; e < BOUNCE_EDGES; e++) {
+            if (e > 0) {
+                k_usleep(BOUNCE_GAP_MIN_US + (e * 53 + b * 97) % BOUNCE_GAP_SPREAD_US);
+            }
+            level = !level;
+            tl_stable = ztl_time__now_us();
+            inject(0, level);
+        }
+
+        zassert_ok(k_sem_take(&probe->sem, K_USEC(DEBOUNCE_US + 10 * SAMPLE_PERIOD_US)), "burst %u not debounced", b);
+        zassert_equal(probe->last_event, level ? ZTL_DIGITAL_INPUT_EVENT_TYPE__CHANGE_STATE_TO_ACTIVE_DEBOUNCED :
+                                                 ZTL_DIGITAL_INPUT_EVENT_TYPE__CHANGE_STATE_TO_INACTIVE_DEBOUNCED);
+        int32_t const error_us = (int32_t)(probe->tl_last - tl_stable) - DEBOUNCE_US;
+        error_min_us = MIN(error_min_us, error_us);
+        error_max_us = MAX(error_max_us, error_us);
+        zassert_equal(k_sem_take(&probe->sem, K_USEC(2 * DEBOUNCE_US)), -EAGAIN, "burst %u debounced twice", b);
+    }
+
+    struct ZtlDigitalInputStats stats;
+    zassert_ok(ztl_digital_input__stats(input, &stats));
+    RESULT("\"test\":\"bounce_debounce\",\"bursts\":%u,\"edges_per_burst\":%u,\"debounced\":%ld,"
+           "\"error_us\":{\"min\":%d,\"max\":%d},\"engine_debounce_error_max_us\":%u",
+           BURST_COUNT, BOUNCE_EDGES, (long)atomic_get(&probe->calls), error_min_us, error_max_us,
+           stats.debounce_error_max_us);
+    zassert_equal(atomic_get(&probe->calls), BURST_COUNT);
+    // Bound of a polled input, a captured one does better, see the results
+    zassert_true(error_min_us >= -SLACK_US, "debounced %d us early", -error_min_us);
+    zassert_true(error_max_us <= SAMPLE_PERIOD_US + SLACK_US, "debounced %d us late", error_max_us);
+}
+
+// Edges of a finite train against the first rising edge, the train must not drift
+ZTEST(io_timing, test_pulse_train_timing) {
+    uint64_t tl_rise[PULSE_COUNT];
+    uint64_t tl_fall[PULSE_COUNT];
+    uint8_t rises = 0;
+    uint8_t falls = 0;
+    bool prev = output_level(0);
+
+    zassert_false(prev);
+    zassert_ok(ztl_digital_output_group__config_pulse_us(&g_group, BIT(0), PULSE_PERIOD_US, PULSE_ON_US));
+    uint64_t const tl_end = ztl_time__now_us() + (PULSE_COUNT + 2) * PULSE_PERIOD_US;
+    zassert_ok(ztl_digital_output_group__start_pulse(&g_group, BIT(0), PULSE_COUNT));
+    while (falls < PULSE_COUNT && ztl_time__now_us() < tl_end) {
+        bool const level = output_level(0);
+        uint64_t const now = ztl_time__now_us();
+        if (level && !prev && rises < PULSE_COUNT) {
+            tl_rise[rises++] = now;
+        } else if (!level && prev && falls < PULSE_COUNT) {
+            tl_fall[falls++] = now;
+        }
+        prev = level;
+        k_usleep(POLL_US);
+    }
+    zassert_equal(rises, PULSE_COUNT);
+    zassert_equal(falls, PULSE_COUNT);
+
+    uint32_t period_error_max_us = 0;
+    uint32_t on_error_max_us = 0;
+    for (uint8_t i = 0; i < PULSE_COUNT; i++) {
+        int64_t const period_error_us = (int64_t)(tl_rise[i] - tl_rise[0]) - (int64_t)i * PULSE_PERIOD_US;
+        int64_t const on_error_us = (int64_t)(tl_fall[i] - tl_rise[i]) - PULSE_ON_US;
+        period_error_max_us = MAX(period_error_max_us, (uint32_t)llabs(period_error_us));
+        on_error_max_us = MAX(on_error_max_us, (uint32_t)llabs(on_error_us));
+    }
+
+    struct ZtlInstrumentEngineStats engine;
+    zassert_ok(ztl_digital_output__engine_stats(&engine));
+    RESULT("\"test\":\"pulse_train\",\"pulses\":%u,\"period_us\":%u,\"on_us\":%u,"
+           "\"error_us\":{\"period_max\":%u,\"on_max\":%u},\"missed\":%u",
+           PULSE_COUNT, PULSE_PERIOD_US, PULSE_ON_US, period_error_max_us, on_error_max_us, engine.missed_deadlines);
+    zassert_true(period_error_max_us <= PULSE_BOUND_US, "period off by %u us", period_error_max_us);
+    zassert_true(on_error_max_us <= PULSE_BOUND_US, "on time off by %u us", on_error_max_us);
+
+    // The train ends on the set state
+    k_usleep(2 * PULSE_PERIOD_US);
+    zassert_false(output_level(0));
+}
+
+// Engine figures with 1, 2, 4... toggling inputs up to all of them, each
+// with every subscriber slot taken, and as many outputs running pulse trains
+ZTEST(io_timing, test_engine_scaling) {
+    uint8_t subscribed = 0;
+
+    for (uint8_t n = 1;; n = MIN(2 * n, INPUT_COUNT)) {
+        for (; subscribed < n; subscribed++) {
+            struct ZtlDigitalInput* const input = setup_input(subscribed, true);
+            for (uint8_t s = 0; s < SUBSCRIBER_COUNT; s++) {
+                zassert_ok(ztl_digital_input__subscribe_to_state_change(
+                    input, true, true, g_subscribers[s], &g_probes[subscribed][s]));
+            }
+        }
+        uint8_t const outputs = MIN(n, OUTPUT_COUNT);
+        uint32_t const output_mask = BIT_MASK(outputs);
+        zassert_ok(ztl_digital_output_group__config_pulse_us(&g_group, output_mask, SCALE_PERIOD_US, SCALE_ON_US));
+        zassert_ok(ztl_digital_output_group__start_pulse(&g_group, output_mask, -1));
+
+        zassert_ok(ztl_digital_input__reset_stats());
+        zassert_ok(ztl_digital_output__reset_stats());
+        uint32_t calls_before = 0;
+        for (uint8_t i = 0; i < n; i++) {
+            for (uint8_t s = 0; s < SUBSCRIBER_COUNT; s++) {
+                calls_before += atomic_get(&g_probes[i][s].calls);
+            }
+        }
+
+        for (uint8_t k = 0; k < SCALE_TOGGLES; k++) {
+            for (uint8_t i = 0; i < n; i++) {
+                inject(i, 0 == k % 2);
+            }
+            k_usleep(SCALE_GAP_US);
+        }
+        zassert_ok(ztl_digital_output_group__stop_pulse(&g_group, output_mask));
+
+        uint32_t calls = 0;
+        uint32_t latency_max_us = 0;
+        uint32_t callback_max_us = 0;
+        for (uint8_t i = 0; i < n; i++) {
+            struct ZtlDigitalInputStats stats;
+            zassert_ok(ztl_digital_input__stats(&g_inputs[i], &stats));
+            for (uint8_t s = 0; s < SUBSCRIBER_COUNT; s++) {
+                calls += atomic_get(&g_probes[i][s].calls);
+                latency_max_us = MAX(latency_max_us, stats.subscribers[s].latency_max_us);
+                callback_max_us = MAX(callback_max_us, stats.subscribers[s].max_us);
+            }
+        }
+        calls -= calls_before;
+
+        struct ZtlInstrumentEngineStats in_engine;
+        struct ZtlInstrumentEngineStats out_engine;
+        zassert_ok(ztl_digital_input__engine_stats(&in_engine));
+        zassert_ok(ztl_digital_output__engine_stats(&out_engine));
+        RESULT("\"test\":\"engine_scaling\",\"inputs\":%u,\"outputs\":%u,\"subscribers\":%u,\"callbacks\":%u,"
+               "\"latency_max_us\":%u,\"callback_max_us\":%u,"
+               "\"input_engine\":{\"passes\":%u,\"duration_max_us\":%u,\"jitter_max_us\":%u,\"missed\":%u},"
+               "\"output_engine\":{\"passes\":%u,\"duration_max_us\":%u,\"jitter_max_us\":%u,\"missed\":%u}",
+               n, outputs, SUBSCRIBER_COUNT, calls, latency_max_us, callback_max_us,
+               in_engine.passes, in_engine.duration_max_us, in_engine.jitter_max_us, in_engine.missed_deadlines,
+               out_engine.passes, out_engine.duration_max_us, out_engine.jitter_max_us, out_engine.missed_deadlines);
+
+        zassert_equal(calls, SCALE_TOGGLES * n * SUBSCRIBER_COUNT, "callbacks lost");
+        zassert_true(latency_max_us <= SLACK_US, "latency %u us with %u inputs", latency_max_us, n);
+        zassert_equal(out_engine.missed_deadlines, 0, "pulse phases missed with %u outputs", outputs);
+
+        if (INPUT_COUNT == n) {
+            break;
+        }
+    }
+}
+
+ZTEST_SUITE(io_timing, NULL, suite_setup, NULL, after, NULL);
@@ -0,0 +1,170 @@
+#include "../../../shift_register.h"
+
+#include <zephyr/device.h>
+#include <zephyr/devicetree.h>
+#include <zephyr/drivers/emul.h>
+#include <zephyr/drivers/gpio.h>
+#include <zephyr/drivers/spi.h>
+#include <zephyr/drivers/spi_emul.h>
+#include <zephyr/ztest.h>
+
+#define DT_DRV_COMPAT ztl_shift_register_chain
+
+enum {
+    IN_BYTES = DT_INST_PROP(0, input_bytes),
+    OUT_BYTES = DT_INST_PROP(0, output_bytes),
+    FRAME_BYTES = MAX(IN_BYTES, OUT_BYTES),
+};
+
+// 74HC165 and 74HC595 of the chain, chip 0 is the one next to the controller
+typedef struct ChainEmul {
+    // Parallel inputs of the 74HC165s, loaded at the start of a frame
+    uint8_t inputs[IN_BYTES];
+    uint8_t in_stages[IN_BYTES];
+    uint8_t out_stages[OUT_BYTES];
+    // Storage registers of the 74HC595s, loaded at the end of a frame
+    uint8_t outputs[OUT_BYTES];
+    uint32_t frames;
+    size_t frame_len;
+} ChainEmul;
+
+static struct ChainEmul g_emul;
+
+static struct device const* const g_port = DEVICE_DT_GET(DT_NODELABEL(io_port0));
+
+static size_t buf_set_len(struct spi_buf_set const* const set) {
+    size_t len = 0;
+    for (size_t i = 0; NULL != set && i < set->count; i++) {
+        len += set->buffers[i].len;
+    }
+    return len;
+}
+
+static uint8_t* buf_set_byte(struct spi_buf_set const* const set, size_t idx) {
+    for (size_t i = 0; NULL != set && i < set->count; i++) {
+        if (idx < set->buffers[i].len) {
+            return NULL != set->buffers[i].buf ? (uint8_t*)set->buffers[i].buf + idx : NULL;
+        }
+        idx -= set->buffers[i].len;
+    }
+    return NULL;
+}
+
+// The controller clocks as many bytes as the longer buffer set, bytes past
+// the end of the tx set go out as 0
+static int chain_emul_io(
+    struct emul const* const target,
+    struct spi_config const* const config,
+    struct spi_buf_set const* const tx_bufs,
+    struct spi_buf_set const* const rx_bufs)
+{
+    ChainEmul* const emul = target->data;
+    size_t const len = MAX(buf_set_len(tx_bufs), buf_set_len(rx_bufs));
+
+    memcpy(emul->in_stages, emul->inputs, IN_BYTES);
+    for (size_t i = 0; i < len; i++) {
+        uint8_t const* const tx = buf_set_byte(tx_bufs, i);
+        uint8_t* const rx = buf_set_byte(rx_bufs, i);
+        if (NULL != rx) {
+            *rx = emul->in_stages[0];
+        }
+        // Serial input of the last 74HC165 is tied low
+        memmove(emul->in_stages, emul->in_stages + 1, IN_BYTES - 1);
+        emul->in_stages[IN_BYTES - 1] = 0;
+        memmove(emul->out_stages + 1, emul->out_stages, OUT_BYTES - 1);
+        emul->out_stages[0] = NULL != tx ? *tx : 0;
+    }
+    // Storage clock tied to the chip select
+    memcpy(emul->outputs, emul->out_stages, OUT_BYTES);
+    emul->frames++;
+    emul->frame_len = len;
+
+    return 0;
+}
+
+static struct spi_emul_api const g_emul_api = {
+    .io = chain_emul_io,
+};
+
+static int chain_emul_init(struct emul const* const target, struct device const* const parent) {
+    return 0;
+}
+
+EMUL_DT_INST_DEFINE(0, chain_emul_init, &g_emul, NULL, &g_emul_api, NULL);
+
+static void configure_pins(gpio_pin_t const first, gpio_pin_t const count, gpio_flags_t const flags) {
+    for (gpio_pin_t pin = first; pin < first + count; pin++) {
+        zassert_ok(gpio_pin_configure(g_port, pin, flags));
+    }
+}
+
+// Chip 0 pins as outputs driven low, chip 1 pins as inputs
+static void before(void* const fixture) {
+    ARG_UNUSED(fixture);
+
+    memset(g_emul.inputs, 0, sizeof(g_emul.inputs));
+    configure_pins(0, 8, GPIO_OUTPUT_INACTIVE);
+    configure_pins(8, 8, GPIO_INPUT);
+}
+
+ZTEST(shift_register, test_outputs_latch_at_frame_end) {
+    uint32_t const frames = g_emul.frames;
+
+    zassert_ok(gpio_port_set_masked_raw(g_port, 0xFF, 0x09));
+    zassert_equal(g_emul.frames, frames + 1, "a write outside a batch is a frame of its own");
+    zassert_equal(g_emul.frame_len, FRAME_BYTES, "tx and rx must clock one frame of the longer length");
+    zassert_equal(g_emul.outputs[0], 0x09);
+
+    // Reading clocks the outputs again, they must come out unchanged
+    gpio_port_value_t value;
+    zassert_ok(gpio_port_get_raw(g_port, &value));
+    zassert_equal(g_emul.outputs[0], 0x09);
+
+    zassert_ok(gpio_port_toggle_bits(g_port, 0x03));
+    zassert_equal(g_emul.outputs[0], 0x0A);
+}
+
+ZTEST(shift_register, test_inputs_read) {
+    g_emul.inputs[0] = 0x3C;
+    g_emul.inputs[1] = 0xA5;
+    zassert_ok(gpio_port_set_masked_raw(g_port, 0xFF, 0x81));
+
+    // Pins of chip 0 read back their output, the 74HC165 byte is masked
+    gpio_port_value_t value;
+    zassert_ok(gpio_port_get_raw(g_port, &value));
+    zassert_equal(value, 0xA581, "got 0x%08x", value);
+
+    configure_pins(0, 8, GPIO_INPUT);
+    zassert_ok(gpio_port_get_raw(g_port, &value));
+    zassert_equal(value, 0xA53C, "got 0x%08x", value);
+}
+
+ZTEST(shift_register, test_batch_shares_frames) {
+    uint32_t const frames = g_emul.frames;
+    gpio_port_value_t value;
+
+    g_emul.inputs[1] = 0x5A;
+    ztl_shift_register__batch_begin();
+    zassert_ok(gpio_port_get_raw(g_port, &value));
+    g_emul.inputs[1] = 0x00;
+    zassert_ok(gpio_port_get_raw(g_port, &value));
+    zassert_equal(g_emul.frames, frames + 1, "reads of a batch share the first frame");
+    zassert_equal(value >> 8, 0x5A, "got 0x%08x", value);
+
+    zassert_ok(gpio_port_set_bits_raw(g_port, 0x40));
+    zassert_ok(gpio_port_set_bits_raw(g_port, 0x02));
+    zassert_equal(g_emul.frames, frames + 1, "writes of a batch wait for its end");
+    zassert_equal(g_emul.outputs[0], 0x00);
+
+    zassert_ok(ztl_shift_register__batch_end());
+    zassert_equal(g_emul.frames, frames + 2);
+    zassert_equal(g_emul.outputs[0], 0x42);
+}
+
+ZTEST(shift_register, test_pin_configure_checks_chips) {
+    // Chip 1 has no 74HC595, chip 2 does not exist
+    zassert_true(gpio_pin_configure(g_port, 8, GPIO_OUTPUT_INACTIVE) < 0);
+    zassert_true(gpio_pin_configure(g_port, 16, GPIO_INPUT) < 0);
+}
+
+ZTEST_SUITE(shift_register, NULL, NULL, before, NULL, NULL);
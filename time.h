@@ -1,10 +1,59 @@
 #ifndef ZTL_TIME_H_
 #define ZTL_TIME_H_
 
+#include <zephyr/kernel.h>
 #include <zephyr/types.h>
 
 typedef uint64_t millis_t;
+typedef uint64_t micros_t;
 
 #define IS_TIME_EXPIRED_EX(tle, period, now) (now - tle >= period || now < tle)
 
-#endif // ZTL_ZTIME_H_
\ No newline at end of file
+// Monotonic time base of the I/O engines, in microseconds. The 64-bit
+// hardware cycle counter gives microsecond resolution where it exists.
+// Without it the value only moves once per kernel tick, so sample periods,
+// debounce times and pulse phases shorter than a tick round up to ticks.
+// Raise CONFIG_SYS_CLOCK_TICKS_PER_SEC on such targets for finer timing.
+static inline micros_t ztl_time__now_us(void) {
+#if defined(CONFIG_TIMER_HAS_64BIT_CYCLE_COUNTER)
+    return k_cyc_to_us_floor64(k_cycle_get_64());
+#else
+    return (micros_t)k_ticks_to_us_floor64(k_uptime_ticks());
+#endif
+}
+
+// Timestamps stored in the I/O objects. The compact layout keeps the low
+// 32 bits, which resolve against a now less than 2^31 us (35 minutes) away.
+#if defined(CONFIG_ZTL_COMPACT_LAYOUT)
+typedef uint32_t ztl_stamp_t;
+#define ZTL_TIME_STAMP_RANGE_US ((uint32_t)INT32_MAX)
+#else
+typedef micros_t ztl_stamp_t;
+#define ZTL_TIME_STAMP_RANGE_US UINT32_MAX
+#endif
+
+// Full time of a stored stamp, in the past or the future of now
+static inline micros_t ztl_time__expand_us(micros_t const now, ztl_stamp_t const stamp) {
+#if defined(CONFIG_ZTL_COMPACT_LAYOUT)
+    return now + (int64_t)(int32_t)(stamp - (uint32_t)now);
+#else
+    ARG_UNUSED(now);
+    return stamp;
+#endif
+}
+
+static inline bool ztl_time__is_stamp_before(ztl_stamp_t const a, ztl_stamp_t const b) {
+#if defined(CONFIG_ZTL_COMPACT_LAYOUT)
+    return (int32_t)(a - b) < 0;
+#else
+    return a < b;
+#endif
+}
+
+// Relative kernel timeout to an absolute deadline of the time base
+static inline k_timeout_t ztl_time__timeout_until_us(micros_t const deadline) {
+    micros_t const now = ztl_time__now_us();
+    return deadline > now ? K_USEC(deadline - now) : K_NO_WAIT;
+}
+
+#endif // ZTL_TIME_H_
@@ -0,0 +1,45 @@
+#ifndef ZTL_VERTICAL_DEBOUNCE_H_
+#define ZTL_VERTICAL_DEBOUNCE_H_
+
+#include <zephyr/types.h>
+
+// Debounces up to 32 pins at once with 2-bit vertical counters: bit N of
+// cnt0/cnt1 is the counter of pin N. A pin takes a new debounced state
+// after 4 consecutive samples differing from the current one, any sample
+// equal to the current state resets its counter.
+typedef struct ZtlVerticalDebounce {
+    uint32_t cnt0;
+    uint32_t cnt1;
+    uint32_t state;
+} ZtlVerticalDebounce;
+
+// Feeds one sample, returns the mask of pins whose debounced state changed.
+// Plain bitwise operations only, safe to call from a timer ISR.
+static inline uint32_t ztl_vertical_debounce__update(
+    struct ZtlVerticalDebounce* const self,
+    uint32_t const sample,
+    uint32_t* const rising,
+    uint32_t* const falling)
+{
+    uint32_t const delta = sample ^ self->state;
+
+    self->cnt1 = (self->cnt1 ^ self->cnt0) & delta;
+    self->cnt0 = ~self->cnt0 & delta;
+
+    uint32_t const toggled = delta & ~(self->cnt0 | self->cnt1);
+    self->state ^= toggled;
+
+    *rising = toggled & self->state;
+    *falling = toggled & ~self->state;
+
+    return toggled;
+}
+
+// Forces the debounced state of the masked pins and restarts their counters
+static inline void ztl_vertical_debounce__reset(struct ZtlVerticalDebounce* const self, uint32_t const mask, uint32_t const state) {
+    self->cnt0 &= ~mask;
+    self->cnt1 &= ~mask;
+    self->state = (self->state & ~mask) | (state & mask);
+}
+
+#endif // ZTL_VERTICAL_DEBOUNCE_H_